@@ -0,0 +1,1009 @@
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "grid.h"
+#include "job.h"
+#include "grid_monothread.h"
+#include "grid_multithread.h"
+#include "checkpoint.h"
+#include "slab.h"
+#include "heuristic.h"
+
+/* Micro-benchmarks for the grid solver building blocks. */
+
+namespace {
+
+  typedef std::chrono::high_resolution_clock bench_clock;
+
+  double seconds_since(bench_clock::time_point t0) {
+    return(std::chrono::duration<double>(bench_clock::now() - t0).count());
+  }
+
+  void register_grid_ids(job_id_manager & m) {
+    for(auto & id : grid_job::get_ids()) {
+      std::string s(id->id());
+      m.register_id(std::move(s),std::move(id));
+    }
+  }
+
+  //Encode/decode throughput of full job serialization.
+  int bench_serialize(int len,long iterations) {
+    job_id_manager m;
+    register_grid_ids(m);
+    std::unique_ptr<grid_job> j(grid_job::make(len,0,grid_engine_recursive,0));
+    std::string ref;
+    job_id_manager::serialize(*j,ref);
+    std::string buf;
+    auto t0(bench_clock::now());
+    for(long i(0);i != iterations;++i) {
+      buf.clear();
+      job_id_manager::serialize(*j,buf);
+    }
+    double enc(seconds_since(t0));
+    t0 = bench_clock::now();
+    for(long i(0);i != iterations;++i) {
+      std::unique_ptr<job> d(m.deserialize(ref,0,ref.size()));
+      if(d == nullptr) {
+        std::cout << "decoding failed" << std::endl;
+        return(-1);
+      }
+    }
+    double dec(seconds_since(t0));
+    std::unique_ptr<job> d(m.deserialize(ref,0,ref.size()));
+    buf.clear();
+    job_id_manager::serialize(*d,buf);
+    if(buf != ref) {
+      std::cout << "round-trip mismatch" << std::endl;
+      return(-1);
+    }
+    std::cout << "serialize n=" << len
+      << " bytes/job=" << ref.size()
+      << " encode=" << static_cast<long>(iterations / enc) << " jobs/s"
+      << " decode=" << static_cast<long>(iterations / dec) << " jobs/s"
+      << std::endl;
+    return(0);
+  }
+
+  /* Grid deserialization of malformed data (as from a farm socket or a
+     checkpoint): a grid holding rooks on the diagonal, serialized, must
+     decode, and must not once any field is out of range. Field offsets
+     are those of the grid format (see grid.cpp). */
+  int bench_malformed(int len) {
+    std::vector< std::tuple<dims,dims,dims> > rs;
+    for(dims i(0);i != len;++i) { rs.push_back(std::make_tuple(i,i,i)); }
+    std::unique_ptr<grid,grid_deleter> g(grid_job::make_grid(len,rs));
+    std::string ref;
+    grid_job::serialize(*g,ref);
+    std::unique_ptr<grid,grid_deleter> d(grid_job::deserialize(ref,0,
+                                                               ref.size()));
+    if(d == nullptr) {
+      std::cout << "malformed: valid grid rejected" << std::endl;
+      return(-1);
+    }
+    struct corruption {
+      const char * field;
+      size_t offset;
+      uint8_t value;
+    };
+    //Offset of gridxy[0], whose bit 1 is not set.
+    size_t planes(10);
+    const corruption cs[] = {
+      { "version",0,0 },
+      { "size",1,static_cast<uint8_t>(max_grid_size + 1) },
+      { "rooks",2,static_cast<uint8_t>(len + 1) },
+      { "rooks (negative)",5,0x80 },
+      { "max_rook_height",6,static_cast<uint8_t>(len) },
+      { "max_rook_height (negative)",6,0xff },
+      { "last_card",7,static_cast<uint8_t>(len + 2) },
+      { "last_card (negative)",7,0xff },
+      { "current_card",8,static_cast<uint8_t>(len + 1) },
+      { "current_card (negative)",8,0xff },
+      { "symmetry",9,0x80 },
+      { "projection bit count",planes,3 },
+    };
+    int failed(0);
+    for(auto & c : cs) {
+      std::string buf(ref);
+      buf[c.offset] = static_cast<char>(c.value);
+      std::unique_ptr<grid,grid_deleter> b(grid_job::deserialize(buf,0,
+                                                                 buf.size()));
+      if(b != nullptr) {
+        std::cout << "malformed: bad " << c.field << " accepted" << std::endl;
+        ++failed;
+      }
+    }
+    //Bit beyond the size in the last byte of gridxy[0], when the size is
+    //not a multiple of 8.
+    if(len % 8 != 0) {
+      std::string buf(ref);
+      size_t last(planes + (len + 7) / 8 - 1);
+      buf[last] = static_cast<char>(buf[last] | (1 << (len % 8)));
+      std::unique_ptr<grid,grid_deleter> b(grid_job::deserialize(buf,0,
+                                                                 buf.size()));
+      if(b != nullptr) {
+        std::cout << "malformed: bit beyond size accepted" << std::endl;
+        ++failed;
+      }
+    }
+    std::cout << "malformed n=" << len << ": " << (failed == 0 ? "ok" : "failed")
+      << std::endl;
+    return(failed == 0 ? 0 : -1);
+  }
+
+  //Round-trip latency of a query_engine query (query + wait_answer,
+  //answered by another thread blocked in wait_query).
+  void bench_query_mode(long iterations,
+                        query_wait_mode mode,
+                        const char * name) {
+    query_engine<long> qe(mode);
+    auto q(qe.get_query_side());
+    auto a(qe.get_answer_side());
+    std::thread t([&]() {
+      for(long i(0);i != iterations;++i) {
+        a.wait_query();
+        ++*(a.get_query());
+        a.answer();
+      }
+    });
+    long v(0);
+    auto t0(bench_clock::now());
+    for(long i(0);i != iterations;++i) {
+      q.query(&v);
+      q.wait_answer();
+    }
+    double d(seconds_since(t0));
+    t.join();
+    std::cout << "query " << name << ": " << iterations << " round-trips, "
+      << (d * 1e6 / iterations) << " us each" << std::endl;
+  }
+
+  int bench_query(long iterations) {
+    bench_query_mode(iterations,query_wait_block,"block");
+    //Much slower: keep it short.
+    bench_query_mode(iterations < 1000 ? iterations : 1000,
+                     query_wait_poll,"poll");
+    return(0);
+  }
+
+  //Run a single-threaded search for at most the given time.
+  //Gives the nodes explored, the time it took, the best number of rooks
+  //found, and whether the search is complete. Also gives each optimum
+  //found with its time, if optima is not null.
+  bool run_for(int len,
+               grid_engine engine,
+               double seconds,
+               uint64_t & nodes,
+               double & elapsed,
+               int & best,
+               int initial_guess = 0,
+               std::vector< std::pair<int,double> > * optima = nullptr) {
+    query_engine<grid_query> gq;
+    query_engine<grid_signal> gs;
+    doorbell bell;
+    gq.set_doorbell(&bell);
+    gs.set_doorbell(&bell);
+    auto pq(gq.get_query_side());
+    auto ps(gs.get_answer_side());
+    grid_worker wk(gq.get_answer_side(),gs.get_query_side());
+    std::thread t([&]() { wk.run(); });
+    grid_query q;
+    q.query_type = go_to_work_code;
+    q.start_job.reset(grid_job::make(len,initial_guess,engine,0));
+    auto t0(bench_clock::now());
+    pq.query(&q);
+    pq.wait_answer();
+    bool done(false);
+    best = initial_guess;
+    //Signals must be answered until the worker is gone.
+    auto handle_signal([&]() {
+      if(ps.have_query()) {
+        auto qr(ps.get_query());
+        if(qr->signal_type == job_done_code) { done = true; }
+        if(qr->signal_type == optimum_code && qr->found_optimum > best) {
+          best = qr->found_optimum;
+          if(optima != nullptr) {
+            optima->push_back(std::make_pair(best,seconds_since(t0)));
+          }
+        }
+        qr->best_grid.reset();
+        ps.answer();
+      }
+    });
+    while(!done && seconds_since(t0) < seconds) {
+      unsigned seen(bell.seen());
+      handle_signal();
+      bell.wait(seen,std::chrono::milliseconds(10));
+    }
+    q.query_type = kill_code;
+    pq.query(&q);
+    while(!pq.have_answer()) {
+      unsigned seen(bell.seen());
+      handle_signal();
+      bell.wait(seen,std::chrono::milliseconds(10));
+    }
+    t.join();
+    elapsed = seconds_since(t0);
+    nodes = wk.nodes();
+    return(done);
+  }
+  
+  //Search speed of the engines, best of several single-threaded runs.
+  //Runs are complete searches (which must agree), or time-boxed if
+  //seconds is positive (for sizes too large to be solved).
+  int bench_engine(int len,long runs,double seconds) {
+    const grid_engine engines[2] = { grid_engine_recursive,grid_engine_stack };
+    const char * names[2] = { "recursive","stack" };
+    double best[2] = { 0,0 };
+    uint64_t nodes[2] = { 0,0 };
+    for(long i(0);i != runs;++i) {
+      for(int e(0);e != 2;++e) {
+        uint64_t n;
+        double d;
+        if(seconds > 0) {
+          int b;
+          run_for(len,engines[e],seconds,n,d,b);
+        } else {
+          grid_monothread gm;
+          auto t0(bench_clock::now());
+          gm.run(len,0,engines[e],0,false,std::chrono::milliseconds(0));
+          d = seconds_since(t0);
+          n = gm.nodes();
+        }
+        if(i == 0 || n / d > nodes[e] / best[e]) {
+          best[e] = d;
+          nodes[e] = n;
+        }
+      }
+    }
+    if(seconds <= 0 && nodes[0] != nodes[1]) {
+      std::cout << "engines disagree on the search" << std::endl;
+      return(-1);
+    }
+    for(int e(0);e != 2;++e) {
+      std::cout << "engine " << names[e] << " n=" << len
+        << " nodes=" << nodes[e]
+        << " time=" << best[e] << " s"
+        << " rate=" << static_cast<long>(nodes[e] / best[e]) << " nodes/s"
+        << std::endl;
+    }
+    return(0);
+  }
+  
+  //Keeps the size of the best grid found.
+  class best_monothread : public grid_monothread {
+  public:
+    inline best_monothread() : grid_monothread(),best(0) {}
+    virtual void register_optimum(const grid & g) {
+      best = grid_job::num_rooks(g);
+    }
+    int best;
+  };
+  
+  //Complete single-threaded searches (stack engine) with every
+  //combination of the grid_symmetry rules, best time of several runs.
+  //They must agree on the optimum.
+  int bench_symmetry(int len,long runs) {
+    const int modes[3] = {
+      0,grid_symmetry_cards,grid_symmetry_cards | grid_symmetry_equilibrium
+    };
+    const char * names[3] = { "none","cards","all" };
+    int optimum(-1);
+    for(int m(0);m != 3;++m) {
+      double best(0);
+      uint64_t nodes(0);
+      for(long i(0);i != runs;++i) {
+        best_monothread gm;
+        auto t0(bench_clock::now());
+        gm.run(len,0,grid_engine_stack,modes[m],
+               false,std::chrono::milliseconds(0));
+        double d(seconds_since(t0));
+        if(i == 0 || d < best) { best = d; }
+        nodes = gm.nodes();
+        if(optimum >= 0 && gm.best != optimum) {
+          std::cout << "symmetry " << names[m] << " finds " << gm.best
+            << " instead of " << optimum << std::endl;
+          return(-1);
+        }
+        optimum = gm.best;
+      }
+      std::cout << "symmetry " << names[m] << " n=" << len
+        << " optimum=" << optimum
+        << " nodes=" << nodes
+        << " time=" << best << " s" << std::endl;
+    }
+    return(0);
+  }
+  
+  //Complete single-threaded searches (recursive engine) with
+  //transposition tables of several sizes, best time of several runs.
+  //They must agree on the optimum.
+  int bench_table(int len,long runs) {
+    const size_t megabytes[4] = { 0,1,16,256 };
+    int optimum(-1);
+    for(int m(0);m != 4;++m) {
+      double best(0);
+      uint64_t nodes(0);
+      uint64_t probes(0);
+      uint64_t hits(0);
+      for(long i(0);i != runs;++i) {
+        best_monothread gm;
+        gm.set_table(megabytes[m] << 20);
+        auto t0(bench_clock::now());
+        gm.run(len,0,grid_engine_recursive,0,
+               false,std::chrono::milliseconds(0));
+        double d(seconds_since(t0));
+        if(i == 0 || d < best) { best = d; }
+        nodes = gm.nodes();
+        probes = gm.table_probes();
+        hits = gm.table_hits();
+        if(optimum >= 0 && gm.best != optimum) {
+          std::cout << "table " << megabytes[m] << " MB finds " << gm.best
+            << " instead of " << optimum << std::endl;
+          return(-1);
+        }
+        optimum = gm.best;
+      }
+      std::cout << "table " << megabytes[m] << " MB n=" << len
+        << " optimum=" << optimum
+        << " nodes=" << nodes
+        << " hits=" << hits << "/" << probes
+        << " time=" << best << " s" << std::endl;
+    }
+    return(0);
+  }
+  
+  //Throughput of grid copies (as for monitoring, optimum signals and
+  //splits) and of split_code round-trips to a worker running stack jobs.
+  //Given jobs go to a pool, from which the worker is fed when it is
+  //done, as grid_multithread does. Also counts the mallocs behind
+  //grids and jobs (see slab.h) in both cases.
+  int bench_split(int len,long iterations) {
+    query_engine<grid_query> gq;
+    query_engine<grid_signal> gs;
+    doorbell bell;
+    gq.set_doorbell(&bell);
+    gs.set_doorbell(&bell);
+    auto pq(gq.get_query_side());
+    auto ps(gs.get_answer_side());
+    grid_worker wk(gq.get_answer_side(),gs.get_query_side());
+    std::thread t([&]() { wk.run(); });
+    auto exchange([&](grid_query & q) {
+      pq.query(&q);
+      while(!pq.have_answer()) {
+        unsigned seen(bell.seen());
+        if(ps.have_query()) {
+          ps.get_query()->best_grid.reset();
+          ps.answer();
+        }
+        bell.wait(seen,std::chrono::milliseconds(10));
+      }
+    });
+    std::vector< std::unique_ptr<grid_job> > pool;
+    pool.emplace_back(grid_job::make(len,0,grid_engine_stack,0));
+    grid_query q;
+    q.query_type = go_to_work_code;
+    q.start_job = std::move(pool.back());
+    pool.pop_back();
+    exchange(q);
+    q.query_type = monitor_code;
+    exchange(q);
+    std::unique_ptr<grid,grid_deleter> snapshot(std::move(q.monitor_grid));
+    if(snapshot == nullptr) {
+      std::cout << "no grid to copy" << std::endl;
+      return(-1);
+    }
+    uint64_t m0(slab_mallocs());
+    auto t0(bench_clock::now());
+    for(long i(0);i != iterations;++i) {
+      std::unique_ptr<grid,grid_deleter> c(grid_job::make_copy(*snapshot));
+    }
+    double copies(seconds_since(t0));
+    uint64_t copy_mallocs(slab_mallocs() - m0);
+    bool working(true);
+    long splits(0);
+    size_t jobs(0);
+    m0 = slab_mallocs();
+    t0 = bench_clock::now();
+    while(splits != iterations) {
+      if(!working) {
+        if(pool.empty()) { break; }
+        q.query_type = go_to_work_code;
+        q.start_job = std::move(pool.back());
+        pool.pop_back();
+        exchange(q);
+        working = true;
+      }
+      q.query_type = split_code;
+      exchange(q);
+      ++splits;
+      jobs += q.jobs.size();
+      for(auto & j : q.jobs) { pool.push_back(std::move(j)); }
+      q.jobs.clear();
+      if(!q.still_working) { working = false; }
+    }
+    double d(seconds_since(t0));
+    uint64_t split_mallocs(slab_mallocs() - m0);
+    q.query_type = kill_code;
+    exchange(q);
+    t.join();
+    std::cout << "split n=" << len
+      << " copy=" << (copies * 1e9 / iterations) << " ns"
+      << " (" << copy_mallocs << " mallocs)"
+      << " split=" << (d * 1e6 / splits) << " us"
+      << " (" << split_mallocs << " mallocs, "
+      << splits << " splits, " << jobs << " jobs)" << std::endl;
+    return(0);
+  }
+  
+  /* Exact search time saved by seeding it with a heuristic grid: the
+     recursive engine (single-threaded, time-boxed) from 0, then from the
+     rooks of the grid found by annealing on the given threads. Without a
+     size, sizes 8 to 11. When the searches are not done in time, the
+     saving is at least the time the unseeded one takes to find as many
+     rooks as the seed. */
+  int bench_seed(int len,double anneal,unsigned threads,double seconds) {
+    int first(len > 0 ? len : 8);
+    int last(len > 0 ? len : 11);
+    for(int n(first);n <= last;++n) {
+      auto t0(bench_clock::now());
+      std::unique_ptr<grid,grid_deleter> g(heuristic_grid(n,anneal,threads));
+      double dh(seconds_since(t0));
+      if(g == nullptr || !grid_job::is_valid(*g)) {
+        std::cout << "seed n=" << n << ": invalid heuristic grid" << std::endl;
+        return(-1);
+      }
+      int k(grid_job::num_rooks(*g));
+      uint64_t nodes[2];
+      double d[2];
+      int best[2];
+      bool done[2];
+      std::vector< std::pair<int,double> > optima;
+      done[0] = run_for(n,grid_engine_recursive,seconds,nodes[0],d[0],
+                        best[0],0,&optima);
+      done[1] = run_for(n,grid_engine_recursive,seconds,nodes[1],d[1],
+                        best[1],k);
+      double reached(-1);
+      for(auto & o : optima) {
+        if(o.first >= k) {
+          reached = o.second;
+          break;
+        }
+      }
+      if(done[1] && best[1] < k) { best[1] = k; }
+      std::cout << "seed n=" << n << " heuristic=" << k << " rooks ("
+        << dh << " s, " << threads << " threads)" << std::endl;
+      const char * names[2] = { "unseeded","seeded" };
+      for(int i(0);i != 2;++i) {
+        std::cout << "  " << names[i] << ": " << best[i] << " rooks, "
+          << nodes[i] << " nodes, "
+          << (done[i] ? "done in " : "stopped after ") << d[i] << " s";
+        if(i == 0) {
+          std::cout << ", ";
+          if(reached < 0) {
+            std::cout << k << " rooks not reached";
+          } else {
+            std::cout << k << " rooks reached at " << reached << " s";
+          }
+        }
+        std::cout << std::endl;
+      }
+      std::cout << "  saved: ";
+      if(done[0] && done[1]) {
+        std::cout << d[0] - d[1] << " s";
+      } else if(reached >= 0) {
+        std::cout << "at least " << reached << " s";
+      } else {
+        std::cout << "more than " << seconds << " s";
+      }
+      std::cout << std::endl;
+    }
+    return(0);
+  }
+
+  //Sizes of the suite: those whose optimum is known (9 is open).
+  const int suite_min_size = 3;
+  const int suite_max_size = 8;
+  //Known optima of the suite sizes.
+  const int known_optima[] = { 6,9,12,18,22,32 };
+  static_assert(sizeof(known_optima) / sizeof(known_optima[0]) ==
+                suite_max_size - suite_min_size + 1,
+                "one known optimum per suite size");
+  //rooks.c bit-sets are 8 bits.
+  const int rooks_max_size = 8;
+  //Rates of shorter runs are noise: they are not compared to a baseline.
+  const double min_compared_time = 0.1;
+
+  /* Decision mode against plain optimization (recursive engine, single
+     thread), for sizes 3 to 8 (or the given one): deciding the optimum
+     (yes), one more (no), and descending to the optimum from slack above
+     it. */
+  int bench_decide(int len,int slack) {
+    int first(len > 0 ? len : suite_min_size);
+    int last(len > 0 ? len : suite_max_size);
+    if(first < suite_min_size || last > suite_max_size) {
+      std::cout << "Optima are known for sizes " << suite_min_size << " to "
+        << suite_max_size << std::endl;
+      return(-1);
+    }
+    for(int n(first);n <= last;++n) {
+      int opt(known_optima[n - suite_min_size]);
+      grid_multithread gm;
+      std::chrono::milliseconds none(0);
+      auto t0(bench_clock::now());
+      gm.run(n,0,grid_engine_recursive,0,1,false,none);
+      double d(seconds_since(t0));
+      std::cout << "decide n=" << n << " optimum " << opt << std::endl;
+      std::cout << "  optimize: " << gm.nodes() << " nodes, " << d << " s"
+        << std::endl;
+      for(int k(opt);k <= opt + 1;++k) {
+        t0 = bench_clock::now();
+        bool found(gm.decide(n,k,grid_engine_recursive,0,1,false,none));
+        d = seconds_since(t0);
+        std::cout << "  decide " << k << ": " << (found ? "yes" : "no")
+          << ", " << gm.nodes() << " nodes, " << d << " s" << std::endl;
+        if(found != (k == opt)) { return(-1); }
+      }
+      t0 = bench_clock::now();
+      int rooks(gm.descend(n,opt + slack,0,grid_engine_recursive,0,1,false,
+                           none));
+      d = seconds_since(t0);
+      std::cout << "  descend from " << opt + slack << ": " << rooks
+        << " rooks, " << gm.decisions() << " decisions, " << gm.nodes()
+        << " nodes, " << d << " s" << std::endl;
+      if(rooks != opt) { return(-1); }
+    }
+    return(0);
+  }
+
+  //Multi-threaded driver timing the optima it finds.
+  class timed_multithread : public grid_multithread {
+  public:
+    inline timed_multithread() : grid_multithread(),t0(bench_clock::now()),
+      best(0),best_time(0) {}
+    virtual void register_optimum(const grid & g) {
+      best = grid_job::num_rooks(g);
+      best_time = seconds_since(t0);
+    }
+    bench_clock::time_point t0;
+    int best;
+    //When the best grid was found.
+    double best_time;
+  };
+
+  /* Pool order of grid_multithread (recursive engine): best bound first
+     against last in first out, from the start job on the given threads,
+     then from the jobs of the grids whose first rows rows are complete
+     (as in shard files, through a checkpoint). Sizes 5 to 8, or the given
+     one. */
+  int bench_order(int len,unsigned threads,int rows) {
+    int first(len > 0 ? len : 5);
+    int last(len > 0 ? len : suite_max_size);
+    std::string file("bench_order.ckpt");
+    for(int n(first);n <= last;++n) {
+      int opt(n >= suite_min_size && n <= suite_max_size ?
+              known_optima[n - suite_min_size] : 0);
+      std::cout << "order n=" << n << " threads=" << threads << std::endl;
+      for(int pooled(0);pooled != 2;++pooled) {
+        if(pooled) {
+          if(rows < 1 || rows >= n) { break; }
+          std::unique_ptr<grid_job> start(grid_job::make(n,0,
+            grid_engine_recursive,0));
+          std::vector< std::unique_ptr<grid_job> > jobs;
+          grid_job::expand(*start,rows,jobs);
+          if(!write_checkpoint(file,n,0,nullptr,jobs)) {
+            std::cout << "Cannot write " << file << std::endl;
+            return(-1);
+          }
+          std::cout << "  from " << jobs.size() << " jobs (" << rows
+            << " rows):" << std::endl;
+        } else {
+          std::cout << "  from the start job:" << std::endl;
+        }
+        for(int best_first(1);best_first >= 0;--best_first) {
+          timed_multithread gm;
+          gm.set_best_first(best_first);
+          std::chrono::milliseconds none(0);
+          if(pooled) {
+            gm.resume(file,threads,false,none);
+          } else {
+            gm.run(n,0,grid_engine_recursive,0,threads,false,none);
+          }
+          double d(seconds_since(gm.t0));
+          std::cout << "    " << (best_first ? "best first" : "lifo      ")
+            << ": " << gm.best << " rooks at " << gm.best_time << " s, done in "
+            << d << " s, " << gm.nodes() << " nodes, " << gm.discarded()
+            << " jobs dropped" << std::endl;
+          if(opt != 0 && gm.best != opt) {
+            std::remove(file.c_str());
+            return(-1);
+          }
+        }
+      }
+    }
+    std::remove(file.c_str());
+    return(0);
+  }
+
+  //One run of the suite.
+  struct suite_run {
+    std::string engine;
+    int size;
+    //complete, wrong, timeout, skipped, unsupported or failed.
+    std::string status;
+    int optimum;
+    //0 if unknown.
+    int expected;
+    uint64_t nodes;
+    double time;
+    long peak_rss_kb;
+  };
+
+  //Run body in a child process, which writes its result to the given
+  //file descriptor, and kill it after the given time.
+  //Gives what it wrote, how long it took and its peak resident memory.
+  //False if it could not run, was killed or failed.
+  bool run_child(const std::function<void(int)> & body,
+                 double seconds,
+                 std::string & out,
+                 double & elapsed,
+                 long & peak_rss_kb) {
+    int fds[2];
+    if(pipe(fds) != 0) { return false; }
+    auto t0(bench_clock::now());
+    pid_t pid(fork());
+    if(pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+    if(pid == 0) {
+      close(fds[0]);
+      body(fds[1]);
+      _exit(0);
+    }
+    close(fds[1]);
+    bool killed(false);
+    char buf[4096];
+    while(true) {
+      double left(seconds - seconds_since(t0));
+      if(left <= 0) {
+        kill(pid,SIGKILL);
+        killed = true;
+        break;
+      }
+      pollfd p;
+      p.fd = fds[0];
+      p.events = POLLIN;
+      p.revents = 0;
+      if(poll(&p,1,static_cast<int>(left * 1000) + 1) <= 0) { continue; }
+      ssize_t r(read(fds[0],buf,sizeof(buf)));
+      if(r < 0 && errno == EINTR) { continue; }
+      if(r <= 0) { break; }
+      out.append(buf,r);
+    }
+    close(fds[0]);
+    int status(0);
+    rusage ru;
+    std::memset(&ru,0,sizeof(ru));
+    while(wait4(pid,&status,0,&ru) < 0 && errno == EINTR) {}
+    elapsed = seconds_since(t0);
+    peak_rss_kb = ru.ru_maxrss;
+    return(!killed && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  //Run of rooks.c (its own process), which prints its result.
+  suite_run suite_rooks(const std::string & rooks,int len,double seconds) {
+    suite_run r{"rooks.c",len,"failed",0,0,0,0,0};
+    if(len > rooks_max_size) {
+      r.status = "unsupported";
+      return(r);
+    }
+    std::string size(std::to_string(len));
+    std::string out;
+    bool ok(run_child([&](int fd) {
+      dup2(fd,1);
+      execl(rooks.c_str(),rooks.c_str(),size.c_str(),
+            static_cast<char *>(nullptr));
+      _exit(127);
+    },seconds,out,r.time,r.peak_rss_kb));
+    if(!ok) {
+      //Killed: the search goes on past the budget.
+      if(r.time >= seconds) { r.status = "timeout"; }
+      return(r);
+    }
+    size_t p(out.find("Result: "));
+    size_t q(out.find("Explored nodes: "));
+    if(p == std::string::npos || q == std::string::npos) { return(r); }
+    r.optimum = std::atoi(out.c_str() + p + 8);
+    r.nodes = std::strtoull(out.c_str() + q + 16,nullptr,10);
+    r.status = "complete";
+    return(r);
+  }
+
+  //Single-threaded run of a grid engine (in a child process, for its
+  //peak memory), time-boxed by the search itself.
+  suite_run suite_grid(const char * name,grid_engine engine,
+                       int len,double seconds) {
+    suite_run r{name,len,"failed",0,0,0,0,0};
+    std::string out;
+    double elapsed;
+    //Leave some time for the child to stop by itself.
+    bool ok(run_child([&](int fd) {
+      uint64_t nodes;
+      double d;
+      int best;
+      bool done(run_for(len,engine,seconds,nodes,d,best));
+      std::ostringstream o;
+      o << (done ? 1 : 0) << ' ' << best << ' ' << nodes << ' ' << d;
+      std::string s(o.str());
+      if(write(fd,s.data(),s.size()) != static_cast<ssize_t>(s.size())) {
+        _exit(1);
+      }
+    },seconds + 10,out,elapsed,r.peak_rss_kb));
+    std::istringstream i(out);
+    int done;
+    if(!ok || !(i >> done >> r.optimum >> r.nodes >> r.time)) { return(r); }
+    r.status = done ? "complete" : "timeout";
+    return(r);
+  }
+
+  double rate(const suite_run & r) {
+    return(r.time > 0 ? r.nodes / r.time : 0);
+  }
+
+  //One run per line, so that a stored suite can be read back by
+  //read_suite.
+  void write_suite(std::ostream & o,double seconds,
+                   const std::vector<suite_run> & runs) {
+    o << "{\"budget\":" << seconds << ",\"runs\":[" << std::endl;
+    for(size_t i(0);i != runs.size();++i) {
+      const suite_run & r(runs[i]);
+      o << "{\"engine\":\"" << r.engine << "\""
+        << ",\"size\":" << r.size
+        << ",\"status\":\"" << r.status << "\""
+        << ",\"optimum\":" << r.optimum
+        << ",\"expected\":" << r.expected
+        << ",\"nodes\":" << r.nodes
+        << ",\"time\":" << r.time
+        << ",\"rate\":" << static_cast<uint64_t>(rate(r))
+        << ",\"peak_rss_kb\":" << r.peak_rss_kb
+        << "}" << (i + 1 == runs.size() ? "" : ",") << std::endl;
+    }
+    o << "]}" << std::endl;
+  }
+
+  //Value of a field of a run written by write_suite (quotes removed).
+  std::string suite_field(const std::string & line,const char * key) {
+    std::string k(std::string("\"") + key + "\":");
+    size_t p(line.find(k));
+    if(p == std::string::npos) { return(std::string()); }
+    p += k.size();
+    size_t e(line.find_first_of(",}",p));
+    std::string v(line.substr(p,e == std::string::npos ? e : e - p));
+    if(v.size() >= 2 && v[0] == '"') { v = v.substr(1,v.size() - 2); }
+    return(v);
+  }
+
+  //Runs of a suite written by write_suite. False if the file cannot
+  //be read.
+  bool read_suite(const std::string & file,std::vector<suite_run> & runs) {
+    std::ifstream f(file);
+    if(!f) { return false; }
+    std::string line;
+    while(std::getline(f,line)) {
+      if(line.find("\"engine\":") == std::string::npos) { continue; }
+      suite_run r;
+      r.engine = suite_field(line,"engine");
+      r.size = std::atoi(suite_field(line,"size").c_str());
+      r.status = suite_field(line,"status");
+      r.optimum = std::atoi(suite_field(line,"optimum").c_str());
+      r.expected = std::atoi(suite_field(line,"expected").c_str());
+      r.nodes = std::strtoull(suite_field(line,"nodes").c_str(),nullptr,10);
+      r.time = std::atof(suite_field(line,"time").c_str());
+      r.peak_rss_kb = std::atol(suite_field(line,"peak_rss_kb").c_str());
+      runs.push_back(r);
+    }
+    return true;
+  }
+
+  //Every engine (rooks.c and the grid engines) on every size of the
+  //suite, each run time-boxed: after a run out of time, the larger sizes
+  //are skipped for that engine. Optima are checked against the known
+  //ones. JSON goes to the output file (or stdout). With a baseline (a
+  //stored output), fails if the rate of a complete run drops by more
+  //than max_regression percents.
+  int bench_suite(const std::string & rooks,
+                  double seconds,
+                  const std::string & output,
+                  const std::string & baseline,
+                  double max_regression) {
+    std::vector<suite_run> base;
+    if(!baseline.empty() && !read_suite(baseline,base)) {
+      std::cerr << "Could not read baseline " << baseline << std::endl;
+      return(-1);
+    }
+    const char * names[4] = { "rooks.c","recursive","stack","floor" };
+    const grid_engine engines[4] = {
+      grid_engine_recursive,grid_engine_recursive,grid_engine_stack,
+      grid_engine_floor
+    };
+    std::vector<suite_run> runs;
+    int result(0);
+    for(int e(0);e != 4;++e) {
+      bool out_of_time(false);
+      for(int len(suite_min_size);len <= suite_max_size;++len) {
+        suite_run r;
+        if(out_of_time) {
+          r = suite_run{names[e],len,"skipped",0,0,0,0,0};
+        } else if(e == 0) {
+          r = suite_rooks(rooks,len,seconds);
+        } else {
+          r = suite_grid(names[e],engines[e],len,seconds);
+        }
+        r.expected = known_optima[len - suite_min_size];
+        if(r.status == "complete" && r.expected != 0 &&
+           r.optimum != r.expected) {
+          r.status = "wrong";
+        }
+        if(r.status == "timeout") { out_of_time = true; }
+        if(r.status == "wrong" || r.status == "failed") {
+          std::cerr << r.engine << " n=" << len << ": " << r.status
+            << " (" << r.optimum << " rooks, expected " << r.expected << ")"
+            << std::endl;
+          result = -1;
+        }
+        std::cerr << r.engine << " n=" << len << " " << r.status
+          << " time=" << r.time << " s" << std::endl;
+        runs.push_back(r);
+      }
+    }
+    for(auto & b : base) {
+      for(auto & r : runs) {
+        if(r.engine != b.engine || r.size != b.size ||
+           r.status != "complete" || b.status != "complete" ||
+           r.time < min_compared_time || b.time < min_compared_time) {
+          continue;
+        }
+        if(rate(r) < rate(b) * (1 - max_regression / 100)) {
+          std::cerr << r.engine << " n=" << r.size << " regressed: "
+            << static_cast<uint64_t>(rate(r)) << " nodes/s instead of "
+            << static_cast<uint64_t>(rate(b)) << std::endl;
+          result = -1;
+        }
+      }
+    }
+    if(output.empty()) {
+      write_suite(std::cout,seconds,runs);
+    } else {
+      std::ofstream f(output);
+      write_suite(f,seconds,runs);
+      if(!f) {
+        std::cerr << "Could not write " << output << std::endl;
+        return(-1);
+      }
+    }
+    return(result);
+  }
+
+  void usage(const char * name) {
+    std::cout << "usage: " << name
+      << " serialize [-n size] [-i iterations]" << std::endl
+      << "   or: " << name << " malformed [-n size]" << std::endl
+      << "   or: " << name << " query [-i iterations]" << std::endl
+      << "   or: " << name << " engine [-n size] [-i runs] [-s seconds]"
+      << std::endl
+      << "   or: " << name << " split [-n size] [-i iterations]" << std::endl
+      << "   or: " << name << " symmetry [-n size] [-i runs]" << std::endl
+      << "   or: " << name << " table [-n size] [-i runs]" << std::endl
+      << "   or: " << name << " suite [-s seconds] [-o output.json]"
+      << " [-b baseline.json] [-x max regression %] [-r rooks]" << std::endl
+      << "   or: " << name << " seed [-n size] [-a anneal seconds] [-t threads]"
+      << " [-s seconds]" << std::endl
+      << "   or: " << name << " decide [-n size] [-u slack]" << std::endl
+      << "   or: " << name << " order [-n size] [-t threads] [-d rows]"
+      << std::endl;
+  }
+
+}
+
+int main(int argc,const char * argv[]) {
+  if(argc < 2) {
+    usage(argv[0]);
+    return(-1);
+  }
+  int len(8);
+  //Default depends on the benchmark.
+  long iterations(-1);
+  double seconds(0);
+  std::string output;
+  std::string baseline;
+  double max_regression(10);
+  double anneal(2);
+  int slack(2);
+  int rows(2);
+  unsigned threads(std::thread::hardware_concurrency());
+  //rooks.c is built next to us.
+  std::string rooks(argv[0]);
+  size_t slash(rooks.rfind('/'));
+  rooks = slash == std::string::npos ? "./rooks"
+    : rooks.substr(0,slash + 1) + "rooks";
+  for(int i(2);i != argc;++i) {
+    if(i+1 == argc) {
+      usage(argv[0]);
+      return(-1);
+    }
+    if(!std::strcmp(argv[i],"-n")) { len = std::atoi(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-i")) { iterations = std::atol(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-s")) { seconds = std::atof(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-o")) { output = argv[++i]; }
+    else if(!std::strcmp(argv[i],"-b")) { baseline = argv[++i]; }
+    else if(!std::strcmp(argv[i],"-x")) { max_regression = std::atof(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-r")) { rooks = argv[++i]; }
+    else if(!std::strcmp(argv[i],"-a")) { anneal = std::atof(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-t")) { threads = std::atoi(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-u")) { slack = std::atoi(argv[++i]); }
+    else if(!std::strcmp(argv[i],"-d")) { rows = std::atoi(argv[++i]); }
+    else {
+      usage(argv[0]);
+      return(-1);
+    }
+  }
+  if(!std::strcmp(argv[1],"serialize")) {
+    return(bench_serialize(len,iterations < 0 ? 1000000 : iterations));
+  }
+  if(!std::strcmp(argv[1],"malformed")) {
+    return(bench_malformed(len));
+  }
+  if(!std::strcmp(argv[1],"query")) {
+    return(bench_query(iterations < 0 ? 1000000 : iterations));
+  }
+  if(!std::strcmp(argv[1],"split")) {
+    return(bench_split(len,iterations < 0 ? 100000 : iterations));
+  }
+  if(!std::strcmp(argv[1],"engine")) {
+    return(bench_engine(len,iterations < 0 ? 3 : iterations,seconds));
+  }
+  if(!std::strcmp(argv[1],"symmetry")) {
+    return(bench_symmetry(len,iterations < 0 ? 1 : iterations));
+  }
+  if(!std::strcmp(argv[1],"table")) {
+    return(bench_table(len,iterations < 0 ? 1 : iterations));
+  }
+  //Only one size if given.
+  bool sized(false);
+  for(int i(2);i != argc;++i) {
+    if(!std::strcmp(argv[i],"-n")) { sized = true; }
+  }
+  if(!std::strcmp(argv[1],"order")) {
+    return(bench_order(sized ? len : 0,threads == 0 ? 1 : threads,rows));
+  }
+  if(!std::strcmp(argv[1],"decide")) {
+    return(bench_decide(sized ? len : 0,slack < 0 ? 0 : slack));
+  }
+  if(!std::strcmp(argv[1],"seed")) {
+    return(bench_seed(sized ? len : 0,anneal,threads == 0 ? 1 : threads,
+                      seconds > 0 ? seconds : 60));
+  }
+  if(!std::strcmp(argv[1],"suite")) {
+    return(bench_suite(rooks,seconds > 0 ? seconds : 60,output,
+                       baseline,max_regression));
+  }
+  usage(argv[0]);
+  return(-1);
+}
+
@@ -1,18 +1,105 @@
-
 #ifndef BITSET_H
 #define BITSET_H
 
 #include <cstddef>
 #include <cinttypes>
 
-/* bitset type. */
-typedef uint16_t bitset;
-/* dimensions for bitset type. This should be enough for
-   the largest bitset types (uint64_t) as well. */
+/* dimensions for bitset types. Grids are less than 127 wide, which the
+   widest bitset type (128 bits) holds. */
 typedef int8_t dims;
 
-//ffs over the integral bitset type.
-#ifdef FAST_FFS
+/* Two 64 bits words, standing for a 128 bits integer when the compiler
+   has none. Only the operations the search needs. */
+struct multiword {
+  inline multiword() : lo(0),hi(0) {}
+  inline multiword(uint64_t v) : lo(v),hi(0) {}
+  inline multiword(uint64_t l,uint64_t h) : lo(l),hi(h) {}
+  inline explicit operator bool() const { return (lo | hi) != 0; }
+  uint64_t lo;
+  uint64_t hi;
+};
+
+inline multiword operator~(const multiword & a) {
+  return multiword(~a.lo,~a.hi);
+}
+inline multiword operator&(const multiword & a,const multiword & b) {
+  return multiword(a.lo & b.lo,a.hi & b.hi);
+}
+inline multiword operator|(const multiword & a,const multiword & b) {
+  return multiword(a.lo | b.lo,a.hi | b.hi);
+}
+inline multiword operator^(const multiword & a,const multiword & b) {
+  return multiword(a.lo ^ b.lo,a.hi ^ b.hi);
+}
+inline multiword operator<<(const multiword & a,int n) {
+  if(n == 0) { return a; }
+  if(n >= 128) { return multiword(); }
+  if(n >= 64) { return multiword(0,a.lo << (n - 64)); }
+  return multiword(a.lo << n,(a.hi << n) | (a.lo >> (64 - n)));
+}
+inline multiword operator>>(const multiword & a,int n) {
+  if(n == 0) { return a; }
+  if(n >= 128) { return multiword(); }
+  if(n >= 64) { return multiword(a.hi >> (n - 64),0); }
+  return multiword((a.lo >> n) | (a.hi << (64 - n)),a.hi >> n);
+}
+inline multiword operator-(const multiword & a,const multiword & b) {
+  return multiword(a.lo - b.lo,a.hi - b.hi - (a.lo < b.lo ? 1 : 0));
+}
+inline bool operator==(const multiword & a,const multiword & b) {
+  return a.lo == b.lo && a.hi == b.hi;
+}
+inline bool operator!=(const multiword & a,const multiword & b) {
+  return !(a == b);
+}
+inline bool operator<(const multiword & a,const multiword & b) {
+  return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+inline bool operator>=(const multiword & a,const multiword & b) {
+  return !(a < b);
+}
+inline multiword & operator&=(multiword & a,const multiword & b) {
+  return a = a & b;
+}
+inline multiword & operator|=(multiword & a,const multiword & b) {
+  return a = a | b;
+}
+inline multiword & operator^=(multiword & a,const multiword & b) {
+  return a = a ^ b;
+}
+inline multiword & operator<<=(multiword & a,int n) { return a = a << n; }
+inline multiword & operator>>=(multiword & a,int n) { return a = a >> n; }
+
+/* bitset types: uint16_t, uint32_t, uint64_t and wide_word.
+   A grid is searched with the narrowest one holding its size (word_for),
+   and stored with the widest one (bitset) so that one grid type
+   fits every size. */
+#if defined(__SIZEOF_INT128__) && !defined(NO_INT128)
+typedef unsigned __int128 wide_word;
+#else
+typedef multiword wide_word;
+#endif
+typedef wide_word bitset;
+
+//Conversion between bitset types (the value must fit).
+template < typename T , typename F > struct word_caster {
+  static inline T cast(F x) { return static_cast<T>(x); }
+};
+template < typename T > struct word_caster<T,multiword> {
+  static inline T cast(multiword x) { return static_cast<T>(x.lo); }
+};
+template < typename F > struct word_caster<multiword,F> {
+  static inline multiword cast(F x) {
+    return multiword(static_cast<uint64_t>(x));
+  }
+};
+template <> struct word_caster<multiword,multiword> {
+  static inline multiword cast(multiword x) { return x; }
+};
+
+template < typename T , typename F > inline T word_cast(F x) {
+  return word_caster<T,F>::cast(x);
+}
 
 //The pre-processor do not want to hear about sizeof, let's do that with
 //templates.
@@ -24,7 +111,26 @@ template < typename T , typename E > struct IF<false,T,E> {
   typedef typename E::res res;
 };
 
-class make_ffs {
+template < typename W > struct word_res {
+  typedef W res;
+};
+
+//Narrowest bitset type holding n bits.
+template < int n > struct word_for {
+  typedef typename
+    IF<n <= 16,
+      word_res<uint16_t>,
+      IF<n <= 32,
+        word_res<uint32_t>,
+        IF<n <= 64,
+          word_res<uint64_t>,
+          word_res<wide_word> > > >::res type;
+};
+
+//ffs over the integral bitset types.
+#ifdef FAST_FFS
+
+template < typename W > class make_ffs {
 private:
   struct ffs_int {
     typedef ffs_int res;
@@ -43,36 +149,80 @@ private:
     typedef unsigned long long input_type;
     static inline int ffs(input_type x) { return __builtin_ffsll(x); }
   };
-  
+
+  //Two ffsll, for 128 bits words.
+  struct ffs_wide {
+    typedef ffs_wide res;
+    typedef W input_type;
+    static inline int ffs(input_type x) {
+      unsigned long long lo(static_cast<unsigned long long>(x));
+      if(lo != 0) { return __builtin_ffsll(lo); }
+      unsigned long long hi(static_cast<unsigned long long>(x >> 64));
+      return(hi != 0 ? 64 + __builtin_ffsll(hi) : 0);
+    }
+  };
+
   struct ffs_failure {};
   typedef typename
-    IF<sizeof(bitset) <= sizeof(ffs_int::input_type),
+    IF<sizeof(W) <= sizeof(typename ffs_int::input_type),
       ffs_int,
-      IF<sizeof(bitset) <= sizeof(ffsl_int::input_type),
+      IF<sizeof(W) <= sizeof(typename ffsl_int::input_type),
          ffsl_int,
-         IF<sizeof(bitset) <= sizeof(ffsll_int::input_type),
+         IF<sizeof(W) <= sizeof(typename ffsll_int::input_type),
             ffsll_int,
-            ffs_failure> > >::res ffs_type;
-public:  
-  static inline int ffs(ffs_type::input_type x) {
+            IF<sizeof(W) <= 2 * sizeof(typename ffsll_int::input_type),
+               ffs_wide,
+               ffs_failure> > > >::res ffs_type;
+public:
+  static inline int ffs(typename ffs_type::input_type x) {
     return ffs_type::ffs(x);
   }
 };
 
-#define FFS_BITSET(lhint,x) make_ffs::ffs(x)
+template <> class make_ffs<multiword> {
+public:
+  static inline int ffs(const multiword & x) {
+    if(x.lo != 0) { return __builtin_ffsll(x.lo); }
+    return(x.hi != 0 ? 64 + __builtin_ffsll(x.hi) : 0);
+  }
+};
+
+//Plain integers (from promotion of narrow bitsets) use the int case.
+template < typename W > inline int ffs_word(W x) {
+  return make_ffs<W>::ffs(x);
+}
+
+#define FFS_BITSET(lhint,x) ffs_word(x)
 #else
-#define FFS_BITSET(lhint,x) ( ([](int _lw,bitset b) {\
-    if(b != 0) {\
-      int lw = _lw;\
-      bitset _1 = static_cast<bitset>(1);\
-      /* Horrible. */\
-      while(!(b & (_1 << lw++))) {}\
-      return lw;\
-    } else {\
-      return 0;\
-    }\
-  })((lhint),(x)) )
+template < typename W > inline int slow_ffs(int lw,W b) {
+  if(b != W(0)) {
+    W _1(1);
+    /* Horrible. */
+    while(!(b & (_1 << lw++))) {}
+    return lw;
+  } else {
+    return 0;
+  }
+}
+#define FFS_BITSET(lhint,x) slow_ffs((lhint),(x))
 #endif
 
+//popcount over the bitset types.
+template < typename W > inline int popcount_word(W x) {
+  return(sizeof(W) <= sizeof(unsigned int) ?
+         __builtin_popcount(static_cast<unsigned int>(x)) :
+         __builtin_popcountll(static_cast<unsigned long long>(x)));
+}
+
+#if defined(__SIZEOF_INT128__) && !defined(NO_INT128)
+inline int popcount_word(unsigned __int128 x) {
+  return(__builtin_popcountll(static_cast<unsigned long long>(x)) +
+         __builtin_popcountll(static_cast<unsigned long long>(x >> 64)));
+}
 #endif
 
+inline int popcount_word(const multiword & x) {
+  return(__builtin_popcountll(x.lo) + __builtin_popcountll(x.hi));
+}
+
+#endif
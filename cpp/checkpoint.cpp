@@ -0,0 +1,104 @@
+
+#include "checkpoint.h"
+#include "serial.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+/* File format (version 1):
+   magic "CRCK", version, size, optimum (32 bits),
+   best grid flag then (32 bits length, grid serialization) if set,
+   job count (32 bits) then (32 bits length, full job serialization)
+   for every job. */
+
+namespace {
+  const char checkpoint_magic[4] = { 'C','R','C','K' };
+  const uint8_t checkpoint_version = 1;
+
+  void put_blob(std::string & buf,const std::string & blob) {
+    put_u32(buf,static_cast<uint32_t>(blob.size()));
+    buf.append(blob);
+  }
+}
+
+bool write_checkpoint(const std::string & file,
+                      dims size,
+                      int optimum,
+                      const grid * best_grid,
+                      const std::vector< std::unique_ptr<grid_job> > & jobs) {
+  std::string buf(checkpoint_magic,4);
+  put_u8(buf,checkpoint_version);
+  put_u8(buf,static_cast<uint8_t>(size));
+  put_i32(buf,optimum);
+  put_u8(buf,best_grid != nullptr);
+  std::string blob;
+  if(best_grid != nullptr) {
+    grid_job::serialize(*best_grid,blob);
+    put_blob(buf,blob);
+  }
+  put_u32(buf,static_cast<uint32_t>(jobs.size()));
+  for(auto & j : jobs) {
+    blob.clear();
+    job_id_manager::serialize(*j,blob);
+    put_blob(buf,blob);
+  }
+  std::string tmp(file + ".tmp");
+  FILE * f(std::fopen(tmp.c_str(),"wb"));
+  if(f == nullptr) { return false; }
+  bool ok(std::fwrite(buf.data(),1,buf.size(),f) == buf.size());
+  ok = (std::fflush(f) == 0) && ok;
+  ok = (fsync(fileno(f)) == 0) && ok;
+  ok = (std::fclose(f) == 0) && ok;
+  if(!ok || std::rename(tmp.c_str(),file.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool read_checkpoint(const std::string & file,grid_checkpoint & out) {
+  std::ifstream in(file.c_str(),std::ios::binary);
+  if(!in) { return false; }
+  std::ostringstream content;
+  content << in.rdbuf();
+  std::string buf(content.str());
+  if(buf.size() < 4 || buf.compare(0,4,checkpoint_magic,4) != 0) {
+    return false;
+  }
+  serial_reader r(buf,4,buf.size());
+  uint8_t version;
+  uint8_t have_grid;
+  int32_t optimum;
+  uint32_t len;
+  if(!r.get_u8(version) || version != checkpoint_version ||
+     !r.get_i8(out.size) || !r.get_i32(optimum) || !r.get_u8(have_grid)) {
+    return false;
+  }
+  out.optimum = optimum;
+  if(have_grid) {
+    if(!r.get_u32(len)) { return false; }
+    size_t start(r.pos());
+    if(!r.skip(len)) { return false; }
+    out.best_grid.reset(grid_job::deserialize(buf,start,r.pos()));
+    if(out.best_grid == nullptr) { return false; }
+  }
+  job_id_manager m;
+  for(auto & id : grid_job::get_ids()) {
+    std::string s(id->id());
+    m.register_id(std::move(s),std::move(id));
+  }
+  uint32_t count;
+  if(!r.get_u32(count)) { return false; }
+  for(uint32_t i(0);i != count;++i) {
+    if(!r.get_u32(len)) { return false; }
+    size_t start(r.pos());
+    if(!r.skip(len)) { return false; }
+    job * j(m.deserialize(buf,start,r.pos()));
+    if(j == nullptr) { return false; }
+    //Only grid jobs were registered.
+    out.jobs.emplace_back(static_cast<grid_job *>(j));
+  }
+  return r.at_end();
+}
+
@@ -0,0 +1,31 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "grid.h"
+
+/* Snapshot of a running search: every pending job, plus the best
+   optimum (and grid, if any) found so far. */
+struct grid_checkpoint {
+  inline grid_checkpoint() : size(0),optimum(0),best_grid(),jobs() {}
+  dims size;
+  int optimum;
+  std::unique_ptr<grid,grid_deleter> best_grid;
+  std::vector< std::unique_ptr<grid_job> > jobs;
+};
+
+//Write a checkpoint atomically: the data goes to a temporary file which
+//is synced then renamed over the target. False on I/O failure.
+bool write_checkpoint(const std::string & file,
+                      dims size,
+                      int optimum,
+                      const grid * best_grid,
+                      const std::vector< std::unique_ptr<grid_job> > & jobs);
+
+//Read a checkpoint back. False if the file cannot be read or is malformed.
+bool read_checkpoint(const std::string & file,grid_checkpoint & out);
+
+#endif
+
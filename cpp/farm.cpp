@@ -0,0 +1,493 @@
+
+#include "farm.h"
+#include "serial.h"
+#include "transposition.h"
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace {
+
+  /* Frames: type (one byte), payload length (32 bits), payload. */
+  enum farm_message {
+    //Coordinator to worker: full job serialization.
+    msg_job = 1,
+    //Coordinator to worker: optimum to register (32 bits).
+    msg_register = 2,
+    //Coordinator to worker: give your continuations back.
+    msg_split = 3,
+    //Coordinator to worker: search over.
+    msg_quit = 4,
+    //Worker to coordinator: optimum (32 bits) then grid serialization.
+    msg_optimum = 5,
+    //Worker to coordinator: job done, waiting for more.
+    msg_done = 6,
+    //Worker to coordinator: job count (32 bits) then
+    //(length (32 bits), full job serialization) for every job.
+    //The worker is idle afterwards.
+    msg_jobs = 7
+  };
+
+  //Parse "unix:<path>", "tcp:<port>" or "tcp:<ipv4>:<port>".
+  bool make_address(const std::string & a,
+                    sockaddr_storage & sa,
+                    socklen_t & len) {
+    std::memset(&sa,0,sizeof(sa));
+    if(a.compare(0,5,"unix:") == 0) {
+      sockaddr_un & su(reinterpret_cast<sockaddr_un &>(sa));
+      std::string path(a,5);
+      if(path.empty() || path.size() >= sizeof(su.sun_path)) { return false; }
+      su.sun_family = AF_UNIX;
+      std::memcpy(su.sun_path,path.c_str(),path.size() + 1);
+      len = sizeof(sockaddr_un);
+      return true;
+    }
+    if(a.compare(0,4,"tcp:") == 0) {
+      sockaddr_in & si(reinterpret_cast<sockaddr_in &>(sa));
+      std::string rest(a,4);
+      std::string host("127.0.0.1");
+      size_t colon(rest.rfind(':'));
+      if(colon != std::string::npos) {
+        host = rest.substr(0,colon);
+        rest = rest.substr(colon + 1);
+      }
+      int port(std::atoi(rest.c_str()));
+      if(port <= 0 || port > 65535) { return false; }
+      si.sin_family = AF_INET;
+      si.sin_port = htons(static_cast<uint16_t>(port));
+      if(inet_pton(AF_INET,host.c_str(),&si.sin_addr) != 1) { return false; }
+      len = sizeof(sockaddr_in);
+      return true;
+    }
+    return false;
+  }
+
+  //Socket with framing. Writes block, reads do not.
+  class farm_link {
+  public:
+    explicit inline farm_link(int fd) : _fd(fd),_in() {}
+    farm_link(const farm_link &) = delete;
+    farm_link & operator=(const farm_link &) = delete;
+    inline ~farm_link() { close(_fd); }
+    inline int fd() const { return _fd; }
+    bool send(int type,const std::string & payload);
+    //Read whatever is available. False on end of stream/error.
+    bool fill();
+    //Extract the next complete frame, if any.
+    bool next(int & type,std::string & payload);
+  private:
+    int _fd;
+    std::string _in;
+  };
+
+  bool farm_link::send(int type,const std::string & payload) {
+    std::string buf;
+    put_u8(buf,static_cast<uint8_t>(type));
+    put_u32(buf,static_cast<uint32_t>(payload.size()));
+    buf.append(payload);
+    size_t done(0);
+    while(done != buf.size()) {
+      ssize_t w(::send(_fd,buf.data() + done,buf.size() - done,MSG_NOSIGNAL));
+      if(w < 0) {
+        if(errno == EINTR) { continue; }
+        return false;
+      }
+      done += w;
+    }
+    return true;
+  }
+
+  bool farm_link::fill() {
+    char chunk[4096];
+    while(true) {
+      ssize_t r(recv(_fd,chunk,sizeof(chunk),MSG_DONTWAIT));
+      if(r > 0) {
+        _in.append(chunk,r);
+        continue;
+      }
+      if(r == 0) { return false; }
+      if(errno == EINTR) { continue; }
+      return(errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+  }
+
+  bool farm_link::next(int & type,std::string & payload) {
+    serial_reader r(_in,0,_in.size());
+    uint8_t t;
+    uint32_t len;
+    if(!r.get_u8(t) || !r.get_u32(len) || r.end() - r.pos() < len) {
+      return false;
+    }
+    type = t;
+    payload.assign(_in,r.pos(),len);
+    _in.erase(0,r.pos() + len);
+    return true;
+  }
+
+  std::string int_payload(int v) {
+    std::string p;
+    put_i32(p,v);
+    return p;
+  }
+
+  void register_grid_ids(job_id_manager & m) {
+    for(auto & id : grid_job::get_ids()) {
+      std::string s(id->id());
+      m.register_id(std::move(s),std::move(id));
+    }
+  }
+
+  //Coordinator view of a worker process.
+  struct farm_peer {
+    inline explicit farm_peer(int fd) : link(fd),busy(false),
+      split_sent(false),dead(false),ledger() {}
+    farm_link link;
+    bool busy;
+    bool split_sent;
+    bool dead;
+    //Serialized job the worker is running.
+    std::string ledger;
+  };
+
+}
+
+farm_coordinator::farm_coordinator() : _reissued(0),_splits(0) {}
+
+farm_coordinator::~farm_coordinator() {}
+
+void farm_coordinator::monitor(const grid &) {}
+
+void farm_coordinator::register_optimum(const grid &) {}
+
+bool farm_coordinator::run(const std::string & address,
+                           dims len,
+                           int initial_guess,
+                           grid_engine engine,
+                           int symmetry) {
+  _reissued = 0;
+  _splits = 0;
+  sockaddr_storage sa;
+  socklen_t sl;
+  if(!make_address(address,sa,sl)) { return false; }
+  int lfd(socket(sa.ss_family,SOCK_STREAM,0));
+  if(lfd < 0) { return false; }
+  if(sa.ss_family == AF_UNIX) {
+    unlink(reinterpret_cast<sockaddr_un &>(sa).sun_path);
+  } else {
+    int one(1);
+    setsockopt(lfd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+  }
+  if(bind(lfd,reinterpret_cast<sockaddr *>(&sa),sl) != 0 ||
+     listen(lfd,64) != 0) {
+    close(lfd);
+    return false;
+  }
+  //Pending serialized jobs, used as a stack.
+  std::vector<std::string> pool(1);
+  {
+    std::unique_ptr<grid_job>
+      j(grid_job::make(len,initial_guess,engine,symmetry));
+    job_id_manager::serialize(*j,pool.back());
+  }
+  int best(initial_guess);
+  std::vector< std::unique_ptr<farm_peer> > peers;
+  auto send([](farm_peer & p,int type,const std::string & payload) {
+    if(!p.dead && !p.link.send(type,payload)) { p.dead = true; }
+  });
+  bool stealing(false);
+  while(true) {
+    std::vector<pollfd> fds(1);
+    fds[0].fd = lfd;
+    fds[0].events = POLLIN;
+    for(auto & p : peers) {
+      pollfd pf;
+      pf.fd = p->link.fd();
+      pf.events = POLLIN;
+      fds.push_back(pf);
+    }
+    if(poll(fds.data(),fds.size(),100) < 0 && errno != EINTR) { break; }
+    if(fds[0].revents & POLLIN) {
+      int fd(accept(lfd,nullptr,nullptr));
+      if(fd >= 0) { peers.emplace_back(new farm_peer(fd)); }
+    }
+    for(size_t i(1);i != fds.size();++i) {
+      if(!fds[i].revents) { continue; }
+      farm_peer & p(*peers[i-1]);
+      if(!p.link.fill()) { p.dead = true; }
+      int type;
+      std::string payload;
+      while(p.link.next(type,payload)) {
+        serial_reader r(payload,0,payload.size());
+        switch(type) {
+        case msg_optimum: {
+          int32_t v;
+          if(!r.get_i32(v) || v <= best) { break; }
+          std::unique_ptr<grid,grid_deleter>
+            g(grid_job::deserialize(payload,r.pos(),r.end()));
+          if(g == nullptr) { break; }
+          best = v;
+          register_optimum(*g);
+          for(auto & q : peers) {
+            if(q.get() != &p) { send(*q,msg_register,int_payload(best)); }
+          }
+          break; }
+        case msg_done: {
+          p.busy = false;
+          p.ledger.clear();
+          break; }
+        case msg_jobs: {
+          uint32_t count(0);
+          r.get_u32(count);
+          for(uint32_t k(0);k != count;++k) {
+            uint32_t l;
+            if(!r.get_u32(l)) { break; }
+            size_t start(r.pos());
+            if(!r.skip(l)) { break; }
+            pool.push_back(payload.substr(start,l));
+          }
+          p.split_sent = false;
+          p.busy = false;
+          p.ledger.clear();
+          stealing = false;
+          break; }
+        default:
+          break;
+        }
+      }
+    }
+    //Re-issue the work of vanished workers.
+    for(size_t i(0);i != peers.size();) {
+      farm_peer & p(*peers[i]);
+      if(!p.dead) {
+        ++i;
+        continue;
+      }
+      if(!p.ledger.empty()) {
+        pool.push_back(std::move(p.ledger));
+        ++_reissued;
+      }
+      if(p.split_sent) { stealing = false; }
+      peers.erase(peers.begin() + i);
+    }
+    //Feed idle workers.
+    bool have_idle(false);
+    for(auto & pp : peers) {
+      farm_peer & p(*pp);
+      if(p.busy || p.split_sent) { continue; }
+      if(pool.empty()) {
+        have_idle = true;
+        continue;
+      }
+      p.ledger = std::move(pool.back());
+      pool.pop_back();
+      p.busy = true;
+      send(p,msg_job,p.ledger);
+      send(p,msg_register,int_payload(best));
+    }
+    //Steal work for idle workers.
+    if(have_idle && !stealing) {
+      for(auto & pp : peers) {
+        farm_peer & p(*pp);
+        if(p.busy && !p.split_sent && !p.dead) {
+          p.split_sent = true;
+          stealing = true;
+          ++_splits;
+          send(p,msg_split,std::string());
+          break;
+        }
+      }
+    }
+    bool finished(pool.empty());
+    for(auto & p : peers) {
+      if(p->busy || p->split_sent) { finished = false; }
+    }
+    if(finished) { break; }
+  }
+  for(auto & p : peers) {
+    send(*p,msg_quit,std::string());
+  }
+  peers.clear();
+  close(lfd);
+  if(sa.ss_family == AF_UNIX) {
+    unlink(reinterpret_cast<sockaddr_un &>(sa).sun_path);
+  }
+  return true;
+}
+
+bool farm_worker_run(const std::string & address,size_t table_bytes) {
+  sockaddr_storage sa;
+  socklen_t sl;
+  if(!make_address(address,sa,sl)) { return false; }
+  int fd(-1);
+  //The coordinator may not be listening yet.
+  for(int attempt(0);attempt != 50;++attempt) {
+    fd = socket(sa.ss_family,SOCK_STREAM,0);
+    if(fd < 0) { return false; }
+    if(connect(fd,reinterpret_cast<sockaddr *>(&sa),sl) == 0) { break; }
+    close(fd);
+    fd = -1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  if(fd < 0) { return false; }
+  farm_link link(fd);
+  job_id_manager m;
+  register_grid_ids(m);
+  query_engine<grid_query> gq;
+  query_engine<grid_signal> gs;
+  //Sleep on the local engines and the socket at the same time.
+  doorbell bell;
+  gq.set_doorbell(&bell);
+  gs.set_doorbell(&bell);
+  auto pq(gq.get_query_side());
+  auto ps(gs.get_answer_side());
+  std::unique_ptr<transposition_table> table;
+  if(table_bytes != 0) { table.reset(new transposition_table(table_bytes)); }
+  grid_worker wk(gq.get_answer_side(),gs.get_query_side(),nullptr,
+                 table.get());
+  std::thread t([&]() { wk.run(); });
+  grid_query gqs;
+  //A job received while a query is in flight waits here: gqs belongs to
+  //the local worker until that query is answered.
+  std::unique_ptr<grid_job> pending;
+  bool busy(false);
+  bool query_sent(false);
+  bool split_wanted(false);
+  int best(0);
+  int known_optimum(0);
+  bool connected(true);
+  auto send_query([&](grid_query_code c) {
+    gqs.query_type = c;
+    query_sent = true;
+    pq.query(&gqs);
+  });
+  auto handle_signal([&]() {
+    if(!ps.have_query()) { return; }
+    auto qr(ps.get_query());
+    switch(qr->signal_type) {
+    case optimum_code: {
+      std::string p(int_payload(qr->found_optimum));
+      grid_job::serialize(*(qr->best_grid),p);
+      if(qr->found_optimum > best) { best = qr->found_optimum; }
+      if(qr->found_optimum > known_optimum) {
+        known_optimum = qr->found_optimum;
+      }
+      qr->best_grid.reset();
+      if(connected && !link.send(msg_optimum,p)) { connected = false; }
+      break; }
+    case job_done_code: {
+      busy = false;
+      if(connected && !link.send(msg_done,std::string())) {
+        connected = false;
+      }
+      break; }
+    }
+    ps.answer();
+  });
+  while(connected) {
+    unsigned seen(bell.seen());
+    if(!link.fill()) {
+      connected = false;
+      break;
+    }
+    int type;
+    std::string payload;
+    bool quit(false);
+    while(link.next(type,payload)) {
+      serial_reader r(payload,0,payload.size());
+      switch(type) {
+      case msg_job: {
+        std::unique_ptr<job> j(m.deserialize(payload,0,payload.size()));
+        if(j == nullptr) {
+          //Should not happen. Report it done rather than hang.
+          link.send(msg_done,std::string());
+          break;
+        }
+        //Only grid jobs were registered.
+        pending.reset(static_cast<grid_job *>(j.release()));
+        busy = true;
+        break; }
+      case msg_register: {
+        int32_t v;
+        if(r.get_i32(v) && v > best) { best = v; }
+        break; }
+      case msg_split: {
+        split_wanted = true;
+        break; }
+      case msg_quit: {
+        quit = true;
+        break; }
+      default:
+        break;
+      }
+    }
+    if(quit) { break; }
+    if(query_sent && pq.have_answer()) {
+      query_sent = false;
+      if(gqs.query_type == get_jobs_code) {
+        //The local worker unwound its call stack, it is now idle.
+        busy = false;
+        std::string p;
+        put_u32(p,static_cast<uint32_t>(gqs.jobs.size()));
+        std::string blob;
+        for(auto & j : gqs.jobs) {
+          blob.clear();
+          job_id_manager::serialize(*j,blob);
+          put_u32(p,static_cast<uint32_t>(blob.size()));
+          p.append(blob);
+        }
+        gqs.jobs.clear();
+        if(!link.send(msg_jobs,p)) { connected = false; }
+      }
+    }
+    if(pending != nullptr && !query_sent) {
+      gqs.start_job = std::move(pending);
+      gqs.start_job->minorate_optimum(best);
+      known_optimum = best;
+      send_query(go_to_work_code);
+    }
+    if(split_wanted && !query_sent) {
+      split_wanted = false;
+      if(busy) {
+        send_query(get_jobs_code);
+      } else {
+        std::string p;
+        put_u32(p,0);
+        if(!link.send(msg_jobs,p)) { connected = false; }
+      }
+    }
+    if(busy && !query_sent && known_optimum < best) {
+      gqs.new_optimum = best;
+      known_optimum = best;
+      send_query(register_code);
+    }
+    handle_signal();
+    bell.wait(seen,std::chrono::milliseconds(1000),link.fd());
+  }
+  //Stop the local worker, answering its signals meanwhile.
+  auto drain([&]() {
+    while(true) {
+      unsigned seen(bell.seen());
+      handle_signal();
+      if(pq.have_answer()) { return; }
+      bell.wait(seen,std::chrono::milliseconds(1000));
+    }
+  });
+  if(query_sent) { drain(); }
+  gqs.jobs.clear();
+  send_query(kill_code);
+  drain();
+  t.join();
+  return true;
+}
+
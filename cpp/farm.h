@@ -0,0 +1,55 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <string>
+#include "grid.h"
+
+/* Multi-process job farm.
+   A coordinator process owns the job pool and hands serialized grid jobs
+   to worker processes connected through a socket. Workers send optimum
+   signals and job completions back, and give their continuations away
+   when the coordinator asks for a split. Improved optima are broadcast
+   to every worker, which forwards them to its job with register_code.
+   The coordinator keeps the job it gave to each worker in a ledger:
+   if a worker disconnects (e.g killed), that job goes back to the pool.
+
+   Addresses are either "unix:<path>" for a Unix-domain socket or
+   "tcp:<port>" / "tcp:<ipv4>:<port>" (127.0.0.1 by default). */
+
+class farm_coordinator {
+public:
+  farm_coordinator();
+  farm_coordinator(const farm_coordinator &) = delete;
+  farm_coordinator(farm_coordinator &&) = delete;
+  farm_coordinator & operator=(const farm_coordinator &) = delete;
+  farm_coordinator & operator=(farm_coordinator &&) = delete;
+  virtual ~farm_coordinator();
+  //Unused: jobs run in other processes. There for symmetry with the
+  //in-process drivers.
+  virtual void monitor(const grid &);
+  //What to do with a fresh optimum grid. Nothing by default.
+  virtual void register_optimum(const grid &);
+  //Serve an instance of the grid problem until it is solved
+  //(symmetry: grid_symmetry flags, which the jobs carry to the workers).
+  //False if the address cannot be listened on.
+  bool run(const std::string & address,
+           dims len,
+           int initial_guess,
+           grid_engine engine,
+           int symmetry);
+  //Number of jobs re-issued because their worker went away.
+  inline unsigned long reissued() const { return _reissued; }
+  //Number of job splits of the last run.
+  inline unsigned long splits() const { return _splits; }
+private:
+  unsigned long _reissued;
+  unsigned long _splits;
+};
+
+//Run a worker process loop against a coordinator, with a transposition
+//table of the given size (0: none) kept across the jobs it gets.
+//False if the coordinator cannot be reached.
+bool farm_worker_run(const std::string & address,size_t table_bytes);
+
+#endif
+
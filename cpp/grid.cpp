@@ -1,50 +1,261 @@
 
 #define FAST_FFS
-//#define EQUILIBRIUM
-//#define OTHER_CARDS
+//Run the search on grids of compile-time size (see size_dispatch).
+#define FIXED_SIZE
+//Count search events by row (see grid_profile).
+#define SEARCH_PROFILE
 #include "grid.h"
+#include "serial.h"
+#include "slab.h"
+#include "transposition.h"
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <limits>
+#include <chrono>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 //This is were all the magical stuff should happen.
 
-struct grid {
+//Count event e of the profile p (if any).
+#ifdef SEARCH_PROFILE
+#define PROFILE_COUNT(p,e) if((p) != nullptr) { ++(p)->e; }
+#else
+#define PROFILE_COUNT(p,e)
+#endif
+
+/* Projections on the three axis of a grid of size n, in a single 64-byte
+   aligned slab block (a copy is one memcpy): gridxy and gridyx (n+1 words),
+   then gridxz, gridzx, gridyz and gridzy (n words).
+   The extra word of gridxy (always set to 0) allows
+   to remove a test for column binary decreasing test by defaulting
+   the previous column (filled in decreasing order) to 0
+   if it do not exists. Same thing in gridyx for row cardinality
+   tie-breaking. */
+template<typename W> struct plane_block {
+  explicit plane_block(dims n) : words(6 * n + 2) {
+    allocate(n);
+    std::memset(gridxy,0,words * sizeof(W));
+  }
+  plane_block(const plane_block & o) : words(o.words) {
+    allocate((words - 2) / 6);
+    std::memcpy(gridxy,o.gridxy,words * sizeof(W));
+  }
+  plane_block(plane_block && o) : words(o.words),
+    gridxy(o.gridxy),gridyx(o.gridyx),gridxz(o.gridxz),
+    gridzx(o.gridzx),gridyz(o.gridyz),gridzy(o.gridzy) {
+    o.words = 0;
+    o.gridxy = NULL;
+  }
+  plane_block & operator=(plane_block o) {
+    std::swap(words,o.words);
+    std::swap(gridxy,o.gridxy);
+    std::swap(gridyx,o.gridyx);
+    std::swap(gridxz,o.gridxz);
+    std::swap(gridzx,o.gridzx);
+    std::swap(gridyz,o.gridyz);
+    std::swap(gridzy,o.gridzy);
+    return(*this);
+  }
+  ~plane_block() { slab_free(gridxy,words * sizeof(W)); }
+  //Words in the block.
+  size_t words;
+  W * gridxy;
+  W * gridyx;
+  W * gridxz;
+  W * gridzx;
+  W * gridyz;
+  W * gridzy;
+private:
+  void allocate(dims n) {
+    gridxy = static_cast<W *>(slab_alloc(words * sizeof(W)));
+    gridyx = gridxy + (n + 1);
+    gridxz = gridyx + (n + 1);
+    gridzx = gridxz + n;
+    gridyz = gridzx + n;
+    gridzy = gridyz + n;
+  }
+};
+
+struct grid : plane_block<bitset> {
+  typedef bitset word;
   explicit grid(dims);
+  //Snapshots come and go with the search.
+  static inline void * operator new(size_t s) { return(slab_alloc(s)); }
+  static inline void operator delete(void * p,size_t s) { slab_free(p,s); }
   //Dimension of the grid.
   dims size;
   //Number of rooks in the grid.
   int rooks;
-  //Projections on the three axis.
-  std::vector<bitset> gridxy;
-  std::vector<bitset> gridyx;
-  std::vector<bitset> gridxz;
-  std::vector<bitset> gridzx;
-  std::vector<bitset> gridyz;
-  std::vector<bitset> gridzy;
   //Maximum allowed rook height (for sorting
   //of rook heights with respect to the traversal order)
   dims max_rook_height;
-#ifdef EQUILIBRIUM
-  //First encountered row cardinal.
-  dims first_card;
-#endif
   //Last encountered row cardinal (for sorting cardinals).
   dims last_card;
   //Cardinal for current row (for sorting row cardinals).
   dims current_card;
-#ifdef OTHER_CARDS
-  //Cardinals for every floors (may break a symmetry).
-  std::vector<dims> floor_cards;
-  //Cardinals for every columns (may break a symmetry).
-  std::vector<dims> column_cards;
-#endif
+  //Extra symmetry breaking (grid_symmetry flags). The cardinals of
+  //rows, columns and floors it needs are popcounts of the projections.
+  uint8_t symmetry;
 };
 
 namespace {
   
   const std::string grid_job_next_pillar_name("grid_job.backtrack_next_pillar");
   const std::string grid_job_pillar_name("grid_job.backtrack_pillar");
+  const std::string grid_job_stack_next_pillar_name
+    ("grid_job_stack.backtrack_next_pillar");
+  const std::string grid_job_stack_pillar_name
+    ("grid_job_stack.backtrack_pillar");
+  //By floor_step.
+  const std::string grid_job_floor_names[5] = {
+    "grid_job_floor.backtrack_corner",
+    "grid_job_floor.backtrack_next_lv",
+    "grid_job_floor.backtrack_next_x",
+    "grid_job_floor.backtrack_next_y",
+    "grid_job_floor.backtrack_left_wing"
+  };
+  
+  //Copy of n words into another bitset type.
+  template<typename S,typename D>
+  inline void copy_words(const S * src,size_t n,D * dst) {
+    std::transform(src,src + n,dst,word_cast<D,S>);
+  }
+  
+  /* Grid on which the engines run (the grid itself stays the format jobs
+     are stored and exchanged in), with the narrowest bitset type holding
+     its size. Only holds what the search uses. */
+  template<typename W> struct word_grid : plane_block<W> {
+    typedef W word;
+    explicit word_grid(const grid & g) : plane_block<W>(g.size),
+      size(g.size),rooks(g.rooks),
+      max_rook_height(g.max_rook_height),
+      last_card(g.last_card),
+      current_card(g.current_card),
+      symmetry(g.symmetry) {
+      //Same layout: sentinels included.
+      copy_words(g.gridxy,g.words,this->gridxy);
+    }
+    dims size;
+    int rooks;
+    dims max_rook_height;
+    dims last_card;
+    dims current_card;
+    uint8_t symmetry;
+  };
+  
+  /* Same with a compile-time size N: constant bounds and masks, and the
+     projections (contiguous, in the same layout) on the stack instead
+     of a heap block. */
+  template<int N> struct alignas(64) fixed_grid {
+    typedef typename word_for<N>::type word;
+    static const dims size = N;
+    explicit fixed_grid(const grid & g) : rooks(g.rooks),
+      max_rook_height(g.max_rook_height),
+      last_card(g.last_card),
+      current_card(g.current_card),
+      symmetry(g.symmetry) {
+      //Sentinels included.
+      copy_words(g.gridxy,N+1,gridxy.data());
+      copy_words(g.gridyx,N+1,gridyx.data());
+      copy_words(g.gridxz,N,gridxz.data());
+      copy_words(g.gridzx,N,gridzx.data());
+      copy_words(g.gridyz,N,gridyz.data());
+      copy_words(g.gridzy,N,gridzy.data());
+    }
+    std::array<word,N+1> gridxy;
+    std::array<word,N+1> gridyx;
+    std::array<word,N> gridxz;
+    std::array<word,N> gridzx;
+    std::array<word,N> gridyz;
+    std::array<word,N> gridzy;
+    int rooks;
+    dims max_rook_height;
+    dims last_card;
+    dims current_card;
+    uint8_t symmetry;
+    //Room for the vector loads of viable_heights past gridzy.
+    word overread[16];
+  };
+  
+  inline grid to_grid(const grid & g) {
+    return(g);
+  }
+  
+  template<typename W> grid to_grid(const word_grid<W> & f) {
+    grid g(f.size);
+    g.rooks = f.rooks;
+    copy_words(f.gridxy,f.words,g.gridxy);
+    g.max_rook_height = f.max_rook_height;
+    g.last_card = f.last_card;
+    g.current_card = f.current_card;
+    g.symmetry = f.symmetry;
+    return(g);
+  }
+  
+  template<int N> grid to_grid(const fixed_grid<N> & f) {
+    grid g(N);
+    g.rooks = f.rooks;
+    copy_words(f.gridxy.data(),N+1,g.gridxy);
+    copy_words(f.gridyx.data(),N+1,g.gridyx);
+    copy_words(f.gridxz.data(),N,g.gridxz);
+    copy_words(f.gridzx.data(),N,g.gridzx);
+    copy_words(f.gridyz.data(),N,g.gridyz);
+    copy_words(f.gridzy.data(),N,g.gridzy);
+    g.max_rook_height = f.max_rook_height;
+    g.last_card = f.last_card;
+    g.current_card = f.current_card;
+    g.symmetry = f.symmetry;
+    return(g);
+  }
+  
+#ifdef FIXED_SIZE
+  //Every size the narrowest bitset type holds.
+  const int max_fixed_size = 16;
+#else
+  const int max_fixed_size = 1;
+#endif
+  
+  /* Run j.search on a copy of g0: a fixed_grid when its size is between
+     2 and N, else a word_grid of the narrowest bitset type (the grid
+     itself past 64). */
+  template<int N> struct size_dispatch {
+    template<typename J> static inline void search(J & j,const grid & g0) {
+      if(g0.size == N) {
+        fixed_grid<N> g(g0);
+        j.search(g);
+      } else {
+        size_dispatch<N-1>::search(j,g0);
+      }
+    }
+  };
+  
+  template<> struct size_dispatch<1> {
+    template<typename J> static inline void search(J & j,const grid & g0) {
+      if(g0.size <= 16) {
+        word_grid<uint16_t> g(g0);
+        j.search(g);
+      } else if(g0.size <= 32) {
+        word_grid<uint32_t> g(g0);
+        j.search(g);
+      } else if(g0.size <= 64) {
+        word_grid<uint64_t> g(g0);
+        j.search(g);
+      } else {
+        grid g(g0);
+        j.search(g);
+      }
+    }
+  };
   
   struct state {
-    explicit inline state(grid && g,dims opt) : g0(g),optimum_so_far(opt) {}
+    explicit inline state(grid && g,int opt) :
+      g0(std::move(g)),optimum_so_far(opt) {}
     grid g0;
     //Part of the state that is not exactly part of the grid.
     //Optimum reached so far.
@@ -52,27 +263,39 @@ namespace {
   };
   
   class grid_job_inter : public grid_job {
+  public:
+    //Jobs are made by the thousand when splitting.
+    static inline void * operator new(size_t s) { return(slab_alloc(s)); }
+    static inline void operator delete(void * p,size_t s) { slab_free(p,s); }
   protected:
-    inline grid_job_inter(grid && g,dims opt) : grid_job(),
+    inline grid_job_inter(grid && g,int opt) : grid_job(),
       s(std::move(g),opt) {}
     state s;
-    void backtrack_pillar(dims x,dims y,dims z);
-    void backtrack_next_pillar(dims x,dims y);
+    //The search works on a copy of s.g0: either a grid or a fixed_grid.
+    template<typename G> void backtrack_pillar(G &,dims x,dims y,dims z);
+    template<typename G> void backtrack_next_pillar(G &,dims x,dims y);
     //It may happen that we want to call that directly from
     //backtrack_pillar.
-    void backtrack_next_row(dims y);
+    template<typename G> void backtrack_next_row(G &,dims y);
     //Do communication stuff (including receiving GetCallStack msg & cie!)
-    inline void communicate();
+    template<typename G> inline void communicate(const G &);
+    //Complete grid reached: signal it if it is better than known.
+    template<typename G> inline void signal_leaf(const G &);
+    //Bound of worth_skipping for s.g0, the given number of pillars
+    //being left in row y.
+    int row_bound(dims pillars,dims y) const;
   };
   
   class grid_job_next_pillar : public grid_job_inter {
   public:
-    grid_job_next_pillar(grid && g,dims x,dims y,dims optimum);
+    grid_job_next_pillar(grid && g,dims x,dims y,int optimum);
     virtual ~grid_job_next_pillar() = default;
     virtual void serialize(std::string &);
     virtual const std::string & get_job_id();
     virtual void run();
     virtual void minorate_optimum(int minopt);
+    virtual int upper_bound() const;
+    template<typename G> void search(G &);
   private:
     dims xstart;
     dims ystart;
@@ -88,12 +311,14 @@ namespace {
   
   class grid_job_pillar : public grid_job_inter {
   public:
-    grid_job_pillar(grid && g,dims x,dims y,dims z,dims optimum);
+    grid_job_pillar(grid && g,dims x,dims y,dims z,int optimum);
     virtual ~grid_job_pillar() = default;
     virtual void serialize(std::string &);
     virtual const std::string & get_job_id();
     virtual void run();
     virtual void minorate_optimum(int minopt);
+    virtual int upper_bound() const;
+    template<typename G> void search(G &);
   private:
     dims xstart;
     dims ystart;
@@ -108,6 +333,202 @@ namespace {
       deserialize(const std::string & s,size_t l,size_t u);
   };
   
+  //What backtrack_pillar keeps in its locals and call frame, for a pillar
+  //with a rook on it (other pillars need no frame).
+  template<typename W> struct stack_frame {
+    dims x;
+    dims y;
+    //Height of the rook on the pillar.
+    dims z;
+    //Entry state, restored when leaving the frame.
+    dims cc;
+    dims lc;
+    dims max_z;
+    int rooks;
+    W gxy;
+    W gyx;
+    W gxz;
+    W gyz;
+    //Floor z before the rook was put there.
+    W gzx;
+    W gzy;
+    //Heights left to try.
+    W guz;
+    //Does a rook fill the row up to the allowed cardinal ?
+    bool max_reached;
+    //Is the rook on the pillar ?
+    bool placed;
+    //Is leaving the pillar empty still to try ?
+    bool skip;
+  };
+  
+  /* Same search as grid_job_pillar/grid_job_next_pillar, over an explicit
+     stack of frames instead of the call stack. Queries never unwind it:
+     split_code gives away the alternatives of the shallowest frame that
+     has some (the job keeps on working), get_jobs_code the alternatives
+     of every frame. */
+  class grid_job_stack : public grid_job_inter {
+  public:
+    grid_job_stack(grid && g,dims x,dims y,dims z,bool next,int optimum);
+    virtual ~grid_job_stack() = default;
+    virtual void serialize(std::string &);
+    virtual const std::string & get_job_id();
+    virtual void run();
+    virtual void minorate_optimum(int minopt);
+    virtual int upper_bound() const;
+    template<typename G> void search(G &);
+  private:
+    //backtrack_pillar(x,y,z0) up to the first rook put.
+    template<typename G> inline void enter(G &,dims x,dims y,dims z0);
+    //Move to the pillar after (x,y), ending the row if (x,y) is its
+    //last pillar. False if the grid is complete.
+    template<typename G> inline bool advance(G &,dims & x,dims & y);
+    //backtrack_next_pillar(x,y).
+    template<typename G> inline void descend(G &,dims x,dims y);
+    //Go on with the top frame.
+    template<typename G> inline void step(G &);
+    //Undo frame d (and what it did) on a grid where every deeper
+    //frame was undone. W is the bitset type of the search.
+    template<typename W> void undo_frame(grid &,size_t d) const;
+    //Job for the alternatives of frame d, given its entry grid.
+    //NULL if it has none.
+    template<typename W> grid_job_stack * alternatives(grid &&,size_t d);
+    //Give away the alternatives of the shallowest frame having some.
+    //False if there is none, i.e the job is over.
+    template<typename G>
+    bool split(const G &,std::vector< std::unique_ptr< grid_job > > &);
+    //Give away every alternative.
+    template<typename G>
+    void give_all(const G &,std::vector< std::unique_ptr< grid_job > > &);
+    //Same as communicate, without exceptions.
+    template<typename G> inline void answer_queries(const G &);
+    dims xstart;
+    dims ystart;
+    dims zstart;
+    //Start with backtrack_next_pillar(xstart,ystart) ?
+    bool next;
+    //Frames of the running search, which has them typed after the
+    //bitset type of its grid.
+    void * frames;
+    template<typename W> inline stack_frame<W> & frame(size_t d) const {
+      return(static_cast<stack_frame<W> *>(frames)[d]);
+    }
+    size_t depth;
+  };
+  
+  class grid_job_stack_id : public job_id {
+  public:
+    inline grid_job_stack_id(bool n) :
+      job_id(n ? grid_job_stack_next_pillar_name : grid_job_stack_pillar_name),
+      next(n) {}
+    virtual ~grid_job_stack_id() = default;
+    virtual grid_job_stack *
+      deserialize(const std::string & s,size_t l,size_t u);
+  private:
+    bool next;
+  };
+  
+  //Where a grid_job_floor starts: the first backtrack_* call it makes.
+  enum floor_step {
+    floor_corner,
+    floor_next_lv,
+    floor_next_x,
+    floor_next_y,
+    floor_left_wing
+  };
+  const int floor_steps = 5;
+  
+  /* What the floor engine keeps besides the projections: rows and
+     columns are ordered by freezing them, in a block [0,xd) x [0,yd)
+     growing from the corner. */
+  struct floor_state {
+    dims xd;
+    dims yd;
+    //Floor being filled.
+    dims lv;
+    //First rook put on floor lv (if any, else on the floor below). The
+    //first rooks of the floors go in lexicographic order.
+    dims xs;
+    dims ys;
+  };
+  
+  /* Grid the floor engine runs on: a word_grid (same bitset types), with
+     its floor_state and the lines floor lv forbids. */
+  template<typename W> struct floor_grid : word_grid<W> {
+    floor_grid(const grid & g,const floor_state & fs) : word_grid<W>(g),
+      f(fs),splitx(0),splity(0) {
+      for(W r(this->gridzy[f.lv]);r != 0;r &= r - 1) {
+        splitx |= this->gridyx[FFS_BITSET(0,r) - 1];
+      }
+      for(W r(this->gridzx[f.lv]);r != 0;r &= r - 1) {
+        splity |= this->gridxy[FFS_BITSET(0,r) - 1];
+      }
+    }
+    floor_state f;
+    /* Columns (rows) where a rook on floor lv would be attacked twice:
+       those meeting a row (column) that has a rook on floor lv. */
+    W splitx;
+    W splity;
+  };
+  
+  /* Floor by floor search of rooks.c. Floors are filled in order, each
+     one in lexicographic order: inside the frozen block, extending it by
+     a column (right wing) or by a row (left wing, as long as it uses
+     columns left of the last ones of the block), or by the corner cell.
+     The optimum does not prune anything.
+     Splits like grid_job_pillar, by unwinding the call stack: each
+     backtrack_* call left to make becomes a job starting with it. */
+  class grid_job_floor : public grid_job_inter {
+  public:
+    grid_job_floor(grid && g,const floor_state & f,floor_step st,
+                   dims oldxd,dims xc,dims yc,int optimum);
+    virtual ~grid_job_floor() = default;
+    virtual void serialize(std::string &);
+    virtual const std::string & get_job_id();
+    virtual void run();
+    virtual void minorate_optimum(int minopt);
+    template<typename W> void search(floor_grid<W> &);
+  private:
+    //Rook on floor lv, saving the forbidden lines.
+    template<typename W>
+    inline void add_rook(floor_grid<W> &,dims x,dims y,W & sx,W & sy);
+    template<typename W>
+    inline void rm_rook(floor_grid<W> &,dims x,dims y,W sx,W sy);
+    //oldxd: columns of the block when the floor started.
+    template<typename W>
+    void backtrack_start_line(floor_grid<W> &,dims oldxd,dims xc,dims yc);
+    template<typename W>
+    void backtrack_inside(floor_grid<W> &,dims oldxd,dims xc,dims yc);
+    template<typename W>
+    void backtrack_next_x(floor_grid<W> &,dims oldxd,dims xc,dims yc);
+    template<typename W>
+    void backtrack_next_y(floor_grid<W> &,dims oldxd,dims yc);
+    template<typename W>
+    void backtrack_left_wing(floor_grid<W> &,dims oldxd,dims xc);
+    template<typename W> void backtrack_corner(floor_grid<W> &);
+    template<typename W> void backtrack_next_lv(floor_grid<W> &);
+    //Add the job for step st from g to a call stack being given away.
+    template<typename W>
+    void give(const floor_grid<W> &,floor_step st,dims oldxd,dims xc,dims yc,
+              std::vector< std::unique_ptr< grid_job > > &);
+    floor_state fstart;
+    floor_step step;
+    dims oldxdstart;
+    dims xstart;
+    dims ystart;
+  };
+  
+  class grid_job_floor_id : public job_id {
+  public:
+    inline grid_job_floor_id(floor_step st) :
+      job_id(grid_job_floor_names[st]),step(st) {}
+    virtual ~grid_job_floor_id() = default;
+    virtual grid_job_floor *
+      deserialize(const std::string & s,size_t l,size_t u);
+  private:
+    floor_step step;
+  };
+  
   class GetCallStackException : public std::exception {
   public:
     inline GetCallStackException
@@ -128,12 +549,31 @@ std::vector< std::unique_ptr< job_id > > grid_job::get_ids() {
   auto gjpi(new grid_job_pillar_id);
   ret.push_back(std::unique_ptr<job_id>(gjnpid));
   ret.push_back(std::unique_ptr<job_id>(gjpi));
+  ret.push_back(std::unique_ptr<job_id>(new grid_job_stack_id(true)));
+  ret.push_back(std::unique_ptr<job_id>(new grid_job_stack_id(false)));
+  for(int st(0);st != floor_steps;++st) {
+    ret.push_back(std::unique_ptr<job_id>
+      (new grid_job_floor_id(static_cast<floor_step>(st))));
+  }
   //Thanks c++11, copy is not allowed anymore
   return ret;
 }
 
-grid_job * grid_job::make(dims len,int initial_guess) {
+grid_job * grid_job::make(dims len,int initial_guess,grid_engine engine,
+                          int symmetry) {
   grid g(len);
+  g.symmetry = static_cast<uint8_t>(symmetry);
+  switch(engine) {
+  case grid_engine_stack:
+    return new grid_job_stack(std::move(g),len-1,len-1,0,false,initial_guess);
+  case grid_engine_floor: {
+    floor_state f = { 0,0,0,0,0 };
+    g.symmetry = 0;
+    return new grid_job_floor(std::move(g),f,floor_corner,0,0,0,
+                              initial_guess); }
+  case grid_engine_recursive:
+    break;
+  }
   return new grid_job_pillar(std::move(g),len-1,len-1,0,initial_guess);
 }
 
@@ -236,41 +676,260 @@ grid * grid_job::make_copy(const grid & g) {
   return(new grid(g));
 }
 
+grid * grid_job::make_grid(dims size,
+                           const std::vector<std::tuple<dims,dims,dims> > & rs) {
+  grid * g(new grid(size));
+  bitset _1(1);
+  for(auto & r : rs) {
+    dims x(std::get<0>(r));
+    dims y(std::get<1>(r));
+    dims z(std::get<2>(r));
+    g->gridxy[x] |= _1 << y;
+    g->gridyx[y] |= _1 << x;
+    g->gridxz[x] |= _1 << z;
+    g->gridzx[z] |= _1 << x;
+    g->gridyz[y] |= _1 << z;
+    g->gridzy[z] |= _1 << y;
+    ++g->rooks;
+  }
+  return(g);
+}
+
+bool grid_job::is_valid(const grid & g) {
+  dims s(g.size);
+  //Two rooks on a line leave fewer bits in a projection than rooks.
+  int pxy(0);
+  int pxz(0);
+  int pyz(0);
+  for(dims i(0);i != s;++i) {
+    pxy += popcount_word(g.gridxy[i]);
+    pxz += popcount_word(g.gridxz[i]);
+    pyz += popcount_word(g.gridyz[i]);
+  }
+  if(pxy != g.rooks || pxz != g.rooks || pyz != g.rooks) { return false; }
+  //have_rook also holds on the empty cells whose three lines are used.
+  int cells(0);
+  for(dims x(0);x != s;++x) {
+    for(dims y(0);y != s;++y) {
+      for(dims z(0);z != s;++z) {
+        if(have_rook(g,x,y,z)) { ++cells; }
+      }
+    }
+  }
+  return(cells == g.rooks);
+}
+
+int grid_job::upper_bound() const {
+  return(std::numeric_limits<int>::max());
+}
+
+void grid_job::expand(grid_job & j,
+                      dims rows,
+                      std::vector< std::unique_ptr<grid_job> > & out) {
+  //Never queried: the job only looks for queries.
+  query_engine<grid_query> gq;
+  query_engine<grid_signal> gs;
+  j.initialize_comm(gq.get_answer_side(),gs.get_query_side());
+  j._prefixes = &out;
+  j._prefix_rows = rows;
+  j.run();
+  j._prefixes = nullptr;
+}
+
+/* Grid format (version 2):
+   version, size, rooks (32 bits), max_rook_height, last_card, current_card,
+   symmetry,
+   then gridxy, gridyx, gridxz, gridzx, gridyz, gridzy, size bitsets each
+   (the always-0 sentinels are not stored). A bitset takes the (size+7)/8
+   low bytes of its value, so the format does not depend on the bitset
+   type the program was compiled with. */
+namespace {
+  const uint8_t grid_format_version = 2;
+  
+  inline size_t bitset_bytes(dims size) { return((size + 7) / 8); }
+  
+  //A bitset as its bitset_bytes(size) low bytes, little-endian (the
+  //bitset type may be a class, see bitset.h).
+  void put_word(std::string & buf,bitset v,size_t bytes) {
+    for(size_t i(0);i != bytes;++i) {
+      put_u8(buf,word_cast<uint8_t>(v));
+      v >>= 8;
+    }
+  }
+  
+  bool get_word(serial_reader & r,bitset & v,size_t bytes) {
+    v = 0;
+    for(size_t i(0);i != bytes;++i) {
+      uint8_t b;
+      if(!r.get_u8(b)) { return false; }
+      v |= word_cast<bitset>(b) << static_cast<int>(8 * i);
+    }
+    return true;
+  }
+  
+  //Projections, in serialization order.
+  bitset * grid::* const grid_planes[6] = {
+    &grid::gridxy,&grid::gridyx,&grid::gridxz,
+    &grid::gridzx,&grid::gridyz,&grid::gridzy
+  };
+}
+
 void grid_job::serialize(const grid & g,std::string & buf) {
-  //TODO.
+  put_u8(buf,grid_format_version);
+  put_u8(buf,static_cast<uint8_t>(g.size));
+  put_i32(buf,g.rooks);
+  put_u8(buf,static_cast<uint8_t>(g.max_rook_height));
+  put_u8(buf,static_cast<uint8_t>(g.last_card));
+  put_u8(buf,static_cast<uint8_t>(g.current_card));
+  put_u8(buf,g.symmetry);
+  size_t w(bitset_bytes(g.size));
+  for(int p(0);p != 6;++p) {
+    const bitset * v(g.*grid_planes[p]);
+    for(dims i(0);i != g.size;++i) {
+      put_word(buf,v[i],w);
+    }
+  }
 }
 
-grid * grid_job::deserialize(std::string & buf,size_t l,size_t u) {
-  //TODO.
-  return(NULL);
+grid * grid_job::deserialize(const std::string & buf,size_t l,size_t u) {
+  serial_reader r(buf,l,u);
+  uint8_t version;
+  int8_t len;
+  if(!r.get_u8(version) || version != grid_format_version) { return(NULL); }
+  if(!r.get_i8(len) || len < 1 || len > max_grid_size) {
+    return(NULL);
+  }
+  std::unique_ptr<grid> g(new grid(len));
+  int32_t rooks;
+  if(!r.get_i32(rooks) || rooks < 0 ||
+     !r.get_i8(g->max_rook_height) ||
+     !r.get_i8(g->last_card) ||
+     !r.get_i8(g->current_card) ||
+     !r.get_u8(g->symmetry) ||
+     (g->symmetry & ~(grid_symmetry_cards | grid_symmetry_equilibrium))) {
+    return(NULL);
+  }
+  //Engines shift by them and index with them.
+  if(g->max_rook_height < 0 || g->max_rook_height >= len ||
+     g->last_card < 0 || g->last_card > len + 1 ||
+     g->current_card < 0 || g->current_card > len) {
+    return(NULL);
+  }
+  g->rooks = rooks;
+  size_t w(bitset_bytes(len));
+  bitset mask(static_cast<bitset>(~static_cast<bitset>(0)) >>
+    (sizeof(bitset) * 8 - len));
+  for(int p(0);p != 6;++p) {
+    bitset * v((*g).*grid_planes[p]);
+    //Every rook is a bit of every projection.
+    int bits(0);
+    for(dims i(0);i != len;++i) {
+      if(!get_word(r,v[i],w) || (v[i] & ~mask)) { return(NULL); }
+      bits += popcount_word(v[i]);
+    }
+    if(bits != rooks) { return(NULL); }
+  }
+  if(!r.at_end()) { return(NULL); }
+  return(g.release());
 }
 
-grid::grid(dims len) : size(len),
+grid::grid(dims len) : plane_block<bitset>(len),
+  size(len),
   rooks(0),
-  //One more (always set to 0) allows
-  //to remove a test for column binary decreasing test by defaulting
-  //the previous column (filled in decreasing order) to 0
-  //if it do not exists.
-  gridxy(len+1,0),
-  //Same thing for row cardinality tie-breaking.
-  gridyx(len+1,0),
-  gridxz(len,0),
-  gridzx(len,0),
-  gridyz(len,0),
-  gridzy(len,0),
   max_rook_height(0),
-#ifdef EQUILIBRIUM
-  first_card(len+1),
-#endif
   last_card(len+1),
-  current_card(0)
-#ifdef OTHER_CARDS
-  ,floor_cards(len,0),
-  column_cards(len,0)
+  current_card(0),
+  symmetry(0) {}
+
+void grid_counts::merge(const grid_counts & o) {
+  kept += o.kept;
+  for(auto & p : o.by_permutations) { by_permutations[p.first] += p.second; }
+}
+
+std::string grid_counts::all(dims size) const {
+  /* A class (orbit) of size!^3 / s grids, s being the size of the
+     stabilizer of its grids, has some number a of kept grids, each kept
+     under k = a * s permutations. So every kept grid stands for
+     size!^3 / k grids of its class, and c grids kept under k
+     permutations stand for size!^3 * c / k grids, an integer
+     (k / gcd(c,k) divides size!^3).
+     The total may not fit 64 bits: it is summed in base 10^9 digits. */
+  const uint64_t base(1000000000);
+  uint64_t group(1);
+  for(int k(2);k <= size;++k) { group *= k; }
+  group = group * group * group;
+  std::vector<uint64_t> total;
+  auto digits([&](uint64_t v) {
+    std::vector<uint64_t> d;
+    for(;v != 0;v /= base) { d.push_back(v % base); }
+    return(d);
+  });
+  for(auto & p : by_permutations) {
+    uint64_t a(p.second);
+    uint64_t b(p.first);
+    while(b != 0) {
+      uint64_t t(a % b);
+      a = b;
+      b = t;
+    }
+    std::vector<uint64_t> u(digits(p.second / a));
+    std::vector<uint64_t> v(digits(group / (p.first / a)));
+    for(size_t i(0);i != u.size();++i) {
+      uint64_t carry(0);
+      for(size_t j(0);j != v.size() || carry != 0;++j) {
+        if(i + j == total.size()) { total.push_back(0); }
+        uint64_t t(total[i+j] + carry + (j < v.size() ? u[i] * v[j] : 0));
+        total[i+j] = t % base;
+        carry = t / base;
+      }
+    }
+  }
+  while(!total.empty() && total.back() == 0) { total.pop_back(); }
+  if(total.empty()) { return("0"); }
+  std::string rt(std::to_string(total.back()));
+  for(size_t i(total.size() - 1);i-- != 0;) {
+    std::string d(std::to_string(total[i]));
+    rt += std::string(9 - d.size(),'0') + d;
+  }
+  return(rt);
+}
+
+//Seconds, for profile rates.
+static double profile_clock() {
+  return(std::chrono::duration<double>
+    (std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+grid_profile::grid_profile() : leaves(0),optima(0),
+#ifdef SEARCH_PROFILE
+  enabled(true),
+#else
+  enabled(false),
 #endif
-  {}
+  rate(0),reported_time(profile_clock()),reported_nodes(0) {
+  std::fill(nodes,nodes + max_grid_size,0);
+  std::fill(bound_cuts,bound_cuts + max_grid_size,0);
+  std::fill(order_cuts,order_cuts + max_grid_size,0);
+  std::fill(attack_cuts,attack_cuts + max_grid_size,0);
+}
+
+void grid_profile::report(grid_profile & r) {
+  double now(profile_clock());
+  uint64_t total(0);
+  for(dims y(0);y != max_grid_size;++y) { total += nodes[y]; }
+  if(now > reported_time) {
+    rate = (total - reported_nodes) / (now - reported_time);
+  }
+  reported_time = now;
+  reported_nodes = total;
+  r = *this;
+}
 
 void grid_worker::run() {
+  //Blocks pooled by the worker are freed at once when it stops.
+  struct slab_guard {
+    inline ~slab_guard() { slab_release(); }
+  } release;
   int min_opt = 0;
   grid_signal gs;
   while(true) {
@@ -282,11 +941,14 @@ void grid_worker::run() {
       //However, this may have be sent before the
       //master knew work were done.
       qr->monitor_grid.reset();
+      _profile.report(qr->profile);
       _a.answer();
       break; }
-    case get_jobs_code: {
+    case get_jobs_code:
+    case split_code: {
       //...
       qr->jobs.clear();
+      qr->still_working = false;
       _a.answer();
       break; }
     case kill_code: {
@@ -298,22 +960,42 @@ void grid_worker::run() {
       int proposal = qr->new_optimum;
       if(proposal > min_opt) { min_opt = proposal; }
       _a.answer();
-      return; }
+      break; }
     case go_to_work_code: {
       //Finally!
       std::unique_ptr<grid_job> ptr(std::move(qr->start_job));
       ptr->initialize_comm(_a,_q);
+      ptr->share_bound(_bound);
+      ptr->share_table(_table);
+      ptr->share_counts(_counts);
+      ptr->share_profile(&_profile);
       ptr->minorate_optimum(min_opt);
       _a.answer();
       bool normal_termination = true;
       try {
         ptr->run();
       } catch(GetCallStackException &) {
+        count(*ptr);
+        _a.get_query()->still_working = false;
         _a.answer();
         normal_termination = false;
       } catch(KillWorkerException &) {
+        count(*ptr);
         return;
       }
+      if(normal_termination) {
+        count(*ptr);
+        switch(ptr->end()) {
+        case job_end_done:
+          break;
+        case job_end_given:
+          _a.answer();
+          normal_termination = false;
+          break;
+        case job_end_killed:
+          return;
+        }
+      }
       if(normal_termination) {
         gs.signal_type = job_done_code;
         _q.query(&gs);
@@ -327,33 +1009,60 @@ void grid_worker::run() {
 
 namespace {
   
-  grid_job_next_pillar::grid_job_next_pillar(grid && g,dims x,dims y,dims opt) :
+  grid_job_next_pillar::grid_job_next_pillar(grid && g,dims x,dims y,int opt) :
     grid_job_inter(std::move(g),opt),xstart(x),ystart(y) {}
   
-  void grid_job_next_pillar::serialize(std::string & s) {
-    //TODO.
+  /* Job formats: start coordinates, optimum_so_far (32 bits), then
+     the grid up to the end of the window. */
+  void grid_job_next_pillar::serialize(std::string & buf) {
+    put_u8(buf,static_cast<uint8_t>(xstart));
+    put_u8(buf,static_cast<uint8_t>(ystart));
+    put_i32(buf,s.optimum_so_far);
+    grid_job::serialize(s.g0,buf);
   }
+  
   const std::string & grid_job_next_pillar::get_job_id() {
     return(grid_job_next_pillar_name);
   }
   
   void grid_job_next_pillar::run() {
-    backtrack_next_pillar(xstart,ystart);
+    size_dispatch<max_fixed_size>::search(*this,s.g0);
+  }
+  
+  template<typename G>
+  void grid_job_next_pillar::search(G & g) {
+    backtrack_next_pillar(g,xstart,ystart);
   }
   
   void grid_job_next_pillar::minorate_optimum(int minopt) {
     if(minopt > s.optimum_so_far) { s.optimum_so_far = minopt; }
   }
+
+  int grid_job_inter::row_bound(dims pillars,dims y) const {
+    int cc(s.g0.current_card);
+    int lc(s.g0.last_card);
+    int max_possible_card(cc + pillars > lc ? lc : cc + pillars);
+    return(max_possible_card * y + max_possible_card - cc + s.g0.rooks);
+  }
+  
+  //Pillars x-1 to 0 are left.
+  int grid_job_next_pillar::upper_bound() const {
+    return(row_bound(xstart,ystart));
+  }
   
   grid_job_pillar::grid_job_pillar(grid && g,
                                    dims x,
                                    dims y,
                                    dims z,
-                                   dims opt) :
+                                   int opt) :
     grid_job_inter(std::move(g),opt),xstart(x),ystart(y),zstart(z) {}
   
-  void grid_job_pillar::serialize(std::string &) {
-    //TODO.
+  void grid_job_pillar::serialize(std::string & buf) {
+    put_u8(buf,static_cast<uint8_t>(xstart));
+    put_u8(buf,static_cast<uint8_t>(ystart));
+    put_u8(buf,static_cast<uint8_t>(zstart));
+    put_i32(buf,s.optimum_so_far);
+    grid_job::serialize(s.g0,buf);
   }
   
   const std::string & grid_job_pillar::get_job_id() {
@@ -361,37 +1070,79 @@ namespace {
   }
   
   void grid_job_pillar::run() {
-    backtrack_pillar(xstart,ystart,zstart);
+    size_dispatch<max_fixed_size>::search(*this,s.g0);
+  }
+  
+  template<typename G>
+  void grid_job_pillar::search(G & g) {
+    backtrack_pillar(g,xstart,ystart,zstart);
   }
   
   void grid_job_pillar::minorate_optimum(int minopt) {
     if(minopt > s.optimum_so_far) { s.optimum_so_far = minopt; }
   }
+
+  //Pillar x may still get a rook.
+  int grid_job_pillar::upper_bound() const {
+    return(row_bound(xstart + 1,ystart));
+  }
+  
+  //Read start coordinates, optimum and grid. NULL if malformed.
+  std::unique_ptr<grid> deserialize_job(const std::string & buf,
+                                        size_t l,
+                                        size_t u,
+                                        int ncoords,
+                                        dims * coords,
+                                        int & opt) {
+    serial_reader r(buf,l,u);
+    for(int i(0);i != ncoords;++i) {
+      if(!r.get_i8(coords[i])) { return(nullptr); }
+    }
+    int32_t o;
+    if(!r.get_i32(o)) { return(nullptr); }
+    opt = o;
+    std::unique_ptr<grid> g(grid_job::deserialize(buf,r.pos(),r.end()));
+    if(g != nullptr) {
+      for(int i(0);i != ncoords;++i) {
+        if(coords[i] < 0 || coords[i] >= g->size) { return(nullptr); }
+      }
+    }
+    return(g);
+  }
   
   grid_job_next_pillar *
     grid_job_next_pillar_id::deserialize(const std::string & s,
                                          size_t l,
                                          size_t u) {
-    //TODO.
-    return(NULL);
+    dims c[2];
+    int opt;
+    std::unique_ptr<grid> g(deserialize_job(s,l,u,2,c,opt));
+    if(g == nullptr) { return(NULL); }
+    return(new grid_job_next_pillar(std::move(*g),c[0],c[1],opt));
   }
   
   grid_job_pillar *
     grid_job_pillar_id::deserialize(const std::string & s,size_t l,size_t u) {
-    //TODO
-    return(NULL);
+    dims c[3];
+    int opt;
+    std::unique_ptr<grid> g(deserialize_job(s,l,u,3,c,opt));
+    if(g == nullptr) { return(NULL); }
+    return(new grid_job_pillar(std::move(*g),c[0],c[1],c[2],opt));
   }
   
-  inline void grid_job_inter::communicate() {
+  template<typename G>
+  inline void grid_job_inter::communicate(const G & g) {
     if(_a.have_query()) {
       auto qr(_a.get_query());
       switch(qr->query_type) {
       case monitor_code: {
         qr->monitor_grid =
-          std::unique_ptr<grid,grid_deleter>(grid_job::make_copy(s.g0));
+          std::unique_ptr<grid,grid_deleter>(new grid(to_grid(g)));
+        if(_profile != nullptr) { _profile->report(qr->profile); }
         _a.answer();
         return; }
-      case get_jobs_code: {
+      case get_jobs_code:
+      case split_code: {
         //The answer is the worker responsibility here.
         throw(GetCallStackException(qr->jobs)); }
       case kill_code: {
@@ -410,15 +1161,385 @@ namespace {
     }
   }
   
-  //TODO: should insert communication reading somewhere in those three
-  //procedures.
+  /* Heights of guz where a rook on pillar (x,y) would not attack another
+     one along its floor: neither gridzx[z] & gyx nor gridzy[z] & gxy
+     (gyx and gxy being row y and column x before the rook is put).
+     Floors get back to this state after every deeper search, so that
+     holds for the whole loop over the heights of the pillar. */
+  template<typename G>
+  inline typename G::word viable_heights(const G & g,
+                                         typename G::word guz,
+                                         typename G::word gyx,
+                                         typename G::word gxy) {
+    typedef typename G::word word;
+    word rt(guz);
+    while(guz != 0) {
+      int z(FFS_BITSET(0,guz) - 1);
+      guz &= guz - 1;
+      if((g.gridzx[z] & gyx) || (g.gridzy[z] & gxy)) {
+        rt ^= word(1) << z;
+      }
+    }
+    return(rt);
+  }
+  
+#if defined(__AVX2__) || defined(__SSE2__)
+  //Every height at once: 16 bits words of a fixed_grid, in vectors.
+  template<int N>
+  inline uint16_t viable_heights(const fixed_grid<N> & g,
+                                 uint16_t guz,
+                                 uint16_t gyx,
+                                 uint16_t gxy) {
+#if defined(__AVX2__)
+    __m256i zx(_mm256_loadu_si256
+      (reinterpret_cast<const __m256i *>(g.gridzx.data())));
+    __m256i zy(_mm256_loadu_si256
+      (reinterpret_cast<const __m256i *>(g.gridzy.data())));
+    __m256i hit(_mm256_or_si256
+      (_mm256_and_si256(zx,_mm256_set1_epi16(static_cast<short>(gyx))),
+       _mm256_and_si256(zy,_mm256_set1_epi16(static_cast<short>(gxy)))));
+    __m256i ok(_mm256_cmpeq_epi16(hit,_mm256_setzero_si256()));
+    //One byte per height, in the low half of each 128 bits lane.
+    uint32_t m(_mm256_movemask_epi8
+      (_mm256_packs_epi16(ok,_mm256_setzero_si256())));
+    return(guz & static_cast<uint16_t>((m & 0xff) | ((m >> 8) & 0xff00)));
+#else
+    uint16_t rt(0);
+    for(int k(0);k < N;k += 8) {
+      __m128i zx(_mm_loadu_si128
+        (reinterpret_cast<const __m128i *>(g.gridzx.data() + k)));
+      __m128i zy(_mm_loadu_si128
+        (reinterpret_cast<const __m128i *>(g.gridzy.data() + k)));
+      __m128i hit(_mm_or_si128
+        (_mm_and_si128(zx,_mm_set1_epi16(static_cast<short>(gyx))),
+         _mm_and_si128(zy,_mm_set1_epi16(static_cast<short>(gxy)))));
+      __m128i ok(_mm_cmpeq_epi16(hit,_mm_setzero_si128()));
+      uint32_t m(_mm_movemask_epi8(_mm_packs_epi16(ok,ok)) & 0xff);
+      rt |= static_cast<uint16_t>(m << k);
+    }
+    return(guz & rt);
+#endif
+  }
+#endif
+  
+  /* Rooks that planes k (columns or floors) can still take once pillar
+     (x,y) is skipped, planes[k] being the rows meeting plane k and
+     lines[r] the lines (heights or columns) row r uses.
+     A new rook in plane k can not go to a line already used in a row
+     meeting plane k (one rook would be attacked twice), so the plane has
+     one free line per line no such row uses. It also gets at most one
+     rook per row left: the y rows below, and row y itself if k < cut.
+     With grid_symmetry_cards, no plane holds more than first rooks, and
+     with grid_symmetry_equilibrium as well no more than leaders planes (if
+     leaders is known, i.e non-negative) hold first rooks. Without the
+     cards cap, planes may go past first and are not counted in full, so
+     equilibrium alone would never cut.
+     Negative if these rules are broken already. */
+  template<typename W>
+  inline int planes_capacity(const W * planes,const W * lines,int sz,
+                             int y,int cut,int first,int leaders,
+                             int symmetry) {
+    int rt(0);
+    //Planes holding first rooks, and planes that may get up to it.
+    int full(0);
+    int reaching(0);
+    for(int k(0);k < sz;++k) {
+      W used(0);
+      for(W r(planes[k]);r != 0;r &= r - 1) {
+        used |= lines[FFS_BITSET(0,r) - 1];
+      }
+      int free_lines(sz - popcount_word(used));
+      int rows(y + (k < cut ? 1 : 0));
+      int c(rows < free_lines ? rows : free_lines);
+      int card(popcount_word(planes[k]));
+      if(symmetry & grid_symmetry_cards) {
+        int left(first - card);
+        if(left < 0) { return(-1); }
+        if(left <= c) {
+          c = left;
+          reaching += left > 0 ? 1 : 0;
+        }
+      }
+      full += card == first ? 1 : 0;
+      rt += c;
+    }
+    if((symmetry & grid_symmetry_cards) &&
+       (symmetry & grid_symmetry_equilibrium) && leaders >= 0) {
+      if(full > leaders) { return(-1); }
+      //Every plane past leaders stops one rook short of first.
+      if(full + reaching > leaders) { rt -= full + reaching - leaders; }
+    }
+    return(rt);
+  }
+  
+  /* Can columns and floors still take more than need rooks once pillar
+     (x,y) is skipped ? See planes_capacity. The first row has the
+     largest cardinal (first) of the rows, and once a row has less, the
+     rows having first rooks (leaders) are known. */
+  template<typename G>
+  inline bool capacity_allows(const G & g,dims x,dims y,int need) {
+    int sz(g.size);
+    int first(sz);
+    int leaders(-1);
+    if(g.symmetry != 0 && y != sz - 1) {
+      first = popcount_word(g.gridyx[sz-1]);
+      if(g.last_card < first) {
+        leaders = 0;
+        for(int k(sz-1);k > y && popcount_word(g.gridyx[k]) == first;--k) {
+          ++leaders;
+        }
+      }
+    }
+    return(planes_capacity(&g.gridxy[0],&g.gridyz[0],sz,y,x,
+                           first,leaders,g.symmetry) > need &&
+           planes_capacity(&g.gridzy[0],&g.gridyx[0],sz,y,x > 0 ? sz : 0,
+                           first,leaders,g.symmetry) > need);
+  }
+  
+  /* Transposition key of the grid whose row y was just filled: what the
+     search of rows y-1 to 0 depends on. That is the lines used
+     (gridxz, gridzx), the heights a column can no longer use
+     (a row meeting the column uses them: double attack), how each
+     column compares with the next one (ties still count for binary
+     ordering), and the row ordering state. The cards of the filled rows
+     matter to symmetry breaking only. */
+  template<typename G>
+  inline table_key row_key(const G & g,dims y) {
+    typedef typename G::word word;
+    int sz(g.size);
+    //Heights attacked per column, then the comparisons and row y.
+    word w[max_grid_size + 3];
+    word eq(0);
+    word lt(0);
+    for(int x(0);x < sz;++x) {
+      word attacked(0);
+      for(word r(g.gridxy[x]);r != 0;r &= r - 1) {
+        attacked |= g.gridyz[FFS_BITSET(0,r) - 1];
+      }
+      w[x] = attacked;
+      if(g.gridxy[x] == g.gridxy[x+1]) { eq |= word(1) << x; }
+      if(g.gridxy[x] < g.gridxy[x+1]) { lt |= word(1) << x; }
+    }
+    w[sz] = eq;
+    w[sz+1] = lt;
+    w[sz+2] = g.gridyx[y];
+    table_hasher h;
+    h.add(static_cast<uint64_t>(y) | static_cast<uint64_t>(g.last_card) << 8 |
+          static_cast<uint64_t>(g.max_rook_height) << 16 |
+          static_cast<uint64_t>(g.symmetry) << 24);
+    h.add_bytes(&g.gridxz[0],sz * sizeof(word));
+    h.add_bytes(&g.gridzx[0],sz * sizeof(word));
+    h.add_bytes(w,(sz + 3) * sizeof(word));
+    if(g.symmetry != 0) {
+      for(int k(sz-1);k >= y;--k) {
+        h.add(static_cast<uint64_t>(popcount_word(g.gridyx[k])));
+      }
+    }
+    return(h.key());
+  }
+  
+  //Rows left under which the transposition table is not used: a single
+  //row is searched about as fast as its key is made.
+  const dims table_rows = 2;
+  
+  /* Pillars of a row (from its start) checked against capacity_allows,
+     whose cost grows with the rooks. Up to size 8 the nodes it saves past
+     the second pillar do not pay for it. From size 9 on, columns and
+     floors fill up sooner, and checking up to the fourth pillar pays. */
+  inline int capacity_pillars(int sz) {
+    return(sz <= 8 ? 2 : 4);
+  }
+  
+  /* Can skipping pillar (x,y) still lead to a better grid than opt ?
+     (opt is refreshed from the shared bound if needed.)
+     gxy is column x before the pillar was tried. */
+  template<typename G>
+  inline bool worth_skipping(const G & g,
+                             dims x,
+                             dims y,
+                             typename G::word gxy,
+                             int & opt,
+                             shared_bound * bound,
+                             grid_profile * profile) {
+    //This is THE place to check for valid remaining_count
+    //(adding a rook would not have helped to decrease it)
+    dims cc(g.current_card);
+    //Might add up to x rooks in the full row.
+    dims cce(cc+x);
+    //And it is bounded by last cardinal.
+    dims lc(g.last_card);
+    int max_possible_card(cce > lc ? lc : cce);
+    //This is what we are really allowed to place in the remaining space.
+    int allowed_rooks(max_possible_card - cc);
+    int reachable(max_possible_card * y + allowed_rooks + g.rooks);
+    if(reachable <= opt) {
+      //Well, we obviously will not find anything better here.
+      PROFILE_COUNT(profile,bound_cuts[y]);
+      return false;
+    }
+    //Our copy of the optimum may be stale if other workers share it.
+    if(bound != nullptr) {
+      int shared(bound->get());
+      if(shared > opt) {
+        opt = shared;
+        if(reachable <= shared) {
+          PROFILE_COUNT(profile,bound_cuts[y]);
+          return false;
+        }
+      }
+    }
+    if(gxy < g.gridxy[x+1]) {
+      PROFILE_COUNT(profile,order_cuts[y]);
+      return false;
+    }
+    //The row bound alone ignores columns and floors filling up. Its cost
+    //grows with the rooks, so only pay it at the start of rows.
+    if(x >= g.size - capacity_pillars(g.size) &&
+       !capacity_allows(g,x,y,opt - g.rooks)) {
+      PROFILE_COUNT(profile,bound_cuts[y]);
+      return false;
+    }
+    return true;
+  }
+  
+  inline uint64_t factorial(int n) {
+    uint64_t rt(1);
+    for(int k(2);k <= n;++k) { rt *= k; }
+    return(rt);
+  }
+  
+  /* Permutations of x, y and z (among the size!^3) under which the
+     complete grid g is still one the engine keeps: columns in binary
+     decreasing order, rows by decreasing cardinal then decreasing gridyx
+     for equal cardinals, heights used in traversal order.
+     The heights always leave (size - used)! permutations, and equal
+     columns (or rows) can be swapped freely. Rows only move among rows
+     of the same cardinal: each distinct arrangement of them is checked
+     once its columns are sorted. Cached per thread by grid shape, as
+     optimal grids often share it. */
+  template<typename G>
+  uint64_t kept_permutations(const G & g) {
+    typedef typename G::word word;
+    thread_local std::unordered_map<std::string,uint64_t> cache;
+    int sz(g.size);
+    std::string shape(reinterpret_cast<const char *>(&g.gridyx[0]),
+                      sz * sizeof(word));
+    auto it(cache.find(shape));
+    uint64_t heights(factorial(sz - g.max_rook_height));
+    if(it != cache.end()) { return(it->second * heights); }
+    auto decreasing([](const word & a,const word & b) { return(b < a); });
+    uint64_t same(1);
+    std::vector<word> rows(&g.gridyx[0],&g.gridyx[0] + sz);
+    std::vector<word> cols(&g.gridxy[0],&g.gridxy[0] + sz);
+    std::sort(cols.begin(),cols.end(),decreasing);
+    for(int k(0);k < sz;) {
+      int e(k);
+      while(e < sz && cols[e] == cols[k]) { ++e; }
+      same *= factorial(e - k);
+      k = e;
+    }
+    //Groups of rows of the same cardinal, each in increasing order to
+    //start with, so that next_permutation goes through every arrangement.
+    std::vector<int> starts;
+    for(int k(0);k < sz;) {
+      int e(k);
+      while(e < sz && popcount_word(rows[e]) == popcount_word(rows[k])) {
+        ++e;
+      }
+      std::sort(rows.begin() + k,rows.begin() + e);
+      for(int i(k);i < e;) {
+        int j(i);
+        while(j < e && rows[j] == rows[i]) { ++j; }
+        same *= factorial(j - i);
+        i = j;
+      }
+      starts.push_back(k);
+      k = e;
+    }
+    starts.push_back(sz);
+    uint64_t arrangements(0);
+    std::vector<word> sorted(sz);
+    word _1(1);
+    while(true) {
+      for(int x(0);x < sz;++x) {
+        word c(0);
+        for(int y(0);y < sz;++y) {
+          if(rows[y] & (_1 << x)) { c |= _1 << y; }
+        }
+        sorted[x] = c;
+      }
+      std::sort(sorted.begin(),sorted.end(),decreasing);
+      bool kept(true);
+      word above(0);
+      for(int y(sz-1);y >= 0 && kept;--y) {
+        word r(0);
+        for(int x(0);x < sz;++x) {
+          if(sorted[x] & (_1 << y)) { r |= _1 << x; }
+        }
+        if(y != sz-1 && popcount_word(r) == popcount_word(above) &&
+           r < above) {
+          kept = false;
+        }
+        above = r;
+      }
+      if(kept) { ++arrangements; }
+      size_t k(0);
+      while(k + 1 != starts.size() &&
+            !std::next_permutation(rows.begin() + starts[k],
+                                   rows.begin() + starts[k+1])) {
+        ++k;
+      }
+      if(k + 1 == starts.size()) { break; }
+    }
+    if(cache.size() > (1 << 16)) { cache.clear(); }
+    cache[shape] = same * arrangements;
+    return(same * arrangements * heights);
+  }
+  
+  template<typename G>
+  inline void grid_job_inter::signal_leaf(const G & g) {
+    int candidate = g.rooks;
+    PROFILE_COUNT(_profile,leaves);
+    if(_counts != nullptr) {
+      if(candidate > s.optimum_so_far) {
+        ++_counts->kept;
+        if(_counts->orbits) { ++_counts->by_permutations[kept_permutations(g)]; }
+      }
+      return;
+    }
+    if(_bound != nullptr) {
+      int shared(_bound->get());
+      if(shared > s.optimum_so_far) { s.optimum_so_far = shared; }
+    }
+    if(candidate > s.optimum_so_far) {
+      PROFILE_COUNT(_profile,optima);
+      s.optimum_so_far = candidate;
+      if(_bound != nullptr) { _bound->raise(candidate); }
+      grid_signal gs;
+      gs.signal_type = optimum_code;
+      gs.found_optimum = s.optimum_so_far;
+      auto gr = new grid(to_grid(g));
+      gs.best_grid = std::unique_ptr<grid,grid_deleter>(gr);
+      _q.query(&gs);
+      _q.wait_answer();
+    }
+  }
+  
+  //Queries are answered (communicate) only where the three procedures
+  //below cut the search: pillars failing the consistency check, leaves,
+  //and rows pruned by the table. Pruning happens often
+  //enough for monitoring, and the other nodes skip the query check.
   
-  void grid_job_inter::backtrack_pillar(dims x,dims y,dims z0) {
-    bitset & rgxz(s.g0.gridxz[x]);
-    bitset & rgyz(s.g0.gridyz[y]);
-    bitset gxz(rgxz);
-    bitset gyz(rgyz);
-    dims sz(s.g0.size);
+  template<typename G>
+  void grid_job_inter::backtrack_pillar(G & g,dims x,dims y,dims z0) {
+    typedef typename G::word word;
+    ++_nodes;
+    PROFILE_COUNT(_profile,nodes[y]);
+    word & rgxz(g.gridxz[x]);
+    word & rgyz(g.gridyz[y]);
+    word gxz(rgxz);
+    word gyz(rgyz);
+    dims sz(g.size);
     /* Check consistency of NO update relatively to binary ordering on columns.
        Columns must be in decreasing order for binary ordering. In order
        for this test to be consistent,
@@ -432,52 +1553,40 @@ namespace {
             3) either they were equal, so in case of update the current column
                is at least geq the previous one (remember:
                going in reverse order) */
-    bitset & rgxy(s.g0.gridxy[x]);
-    bitset gxy(rgxy);
+    word & rgxy(g.gridxy[x]);
+    word gxy(rgxy);
     auto consistency_check([&]() {
-      //This is THE place to check for valid remaining_count
-      //(adding a rook would not have helped to decrease it)
-      dims cc(s.g0.current_card);
-      //Might add up to x rooks in the full row.
-      dims cce(cc+x);
-      //And it is bounded by last cardinal.
-      dims lc(s.g0.last_card);
-      int max_possible_card(cce > lc ? lc : cce);
-      //This is what we are really allowed to place in the remaining space.
-      int allowed_rooks(max_possible_card - cc);
-      if(max_possible_card * y + allowed_rooks + s.g0.rooks <= s.optimum_so_far) {
-        //Well, we obviously will not find anything better here.
-        return false;
-      }
-      return(gxy >= s.g0.gridxy[x+1]);
+      return(worth_skipping(g,x,y,gxy,s.optimum_so_far,_bound,_profile));
     });
     //Test for double attack on the pillar.
     //If yes, go directly to next pillar.
-    if(!(gxz & gyz)) {
-      dims cc = s.g0.current_card;
+    if(gxz & gyz) {
+      PROFILE_COUNT(_profile,attack_cuts[y]);
+    } else {
+      dims cc = g.current_card;
       dims cc1 = cc+1;
-      bitset & rgyx(s.g0.gridyx[y]);
-      bitset gyx(rgyx);
-      bitset _1(1);
-      bitset mask_x(_1 << x);
-      bitset ugyx(gyx ^ mask_x);
+      word & rgyx(g.gridyx[y]);
+      word gyx(rgyx);
+      word _1(1);
+      word mask_x(_1 << x);
+      word ugyx(gyx ^ mask_x);
       //Check whether we reached max allowed card.
-      bool max_allowed_card_reached = (cc1 == s.g0.last_card);
+      bool max_allowed_card_reached = (cc1 == g.last_card);
       //Because if we did it is time to check for row ordering.
       if(max_allowed_card_reached) {
-        if(ugyx < s.g0.gridyx[y+1]) {
+        if(ugyx < g.gridyx[y+1]) {
           //If the test fail, this is not even worth checking
           //for other row fillings. Indeed, we can only generates smaller
           //values for the bitset...while wanting bigger ones (remember:
           //iteration in reverse order!)
-          s.g0.last_card = cc;
-          s.g0.current_card = 0;
+          g.last_card = cc;
+          g.current_card = 0;
           auto undo([&]() {
-            s.g0.current_card = cc;
-            s.g0.last_card = cc1;
+            g.current_card = cc;
+            g.last_card = cc1;
           });
           try {
-            backtrack_next_row(y);
+            backtrack_next_row(g,y);
             undo();
           } catch(GetCallStackException &) {
             undo();
@@ -485,43 +1594,48 @@ namespace {
           }
           return;
         } else {
-          s.g0.current_card = 0;
+          g.current_card = 0;
         }
       } else {
-        s.g0.current_card = cc1;
+        g.current_card = cc1;
       }
-      bitset mask_y(_1 << y);
+      word mask_y(_1 << y);
       /* Speculative updates. */
       rgxy = gxy ^ mask_y;
       rgyx = ugyx;
-      int rk = s.g0.rooks;
-      s.g0.rooks = rk+1;
+      int rk = g.rooks;
+      g.rooks = rk+1;
       /* The compiler have better inline this... */
       auto speculative_undo([&]() {
-        s.g0.rooks = rk;
-        s.g0.current_card = cc;
+        g.rooks = rk;
+        g.current_card = cc;
         rgyx = gyx;
         rgxy = gxy;
       });
-      int max_z = s.g0.max_rook_height;
+      int max_z = g.max_rook_height;
       int maj_z = max_z + 1;
-      //set of allowed z with respect to direct attacks.
-      bitset guz = ((~(gxz | gyz)) & ((_1 << maj_z) - 1)) >> z0;
+      //set of allowed z with respect to direct attacks, then to double
+      //attacks on row/columns.
+      //(Two shifts: maj_z may be the width of word.)
+      word free_z((~(gxz | gyz)) &
+                  (((_1 << max_z) << 1) - 1) &
+                  ~((_1 << z0) - 1));
+      word guz = viable_heights(g,free_z,gyx,gxy) >> z0;
+      if(guz == 0 && free_z != 0) {
+        PROFILE_COUNT(_profile,attack_cuts[y]);
+      }
       int z = (z0-1);
       while(true) {
         int offset = FFS_BITSET(0,guz);
         if(offset == 0) { break; }
-        guz >>= offset;
+        //(offset may be the width of word.)
+        guz = (guz >> (offset - 1)) >> 1;
         z += offset;
-        bitset & rgzx(s.g0.gridzx[z]);
-        bitset & rgzy(s.g0.gridzy[z]);
-        bitset gzx(rgzx);
-        bitset gzy(rgzy);
-        /* Test for potential double attacks on row/columns. */
-        if((gzx & gyx) || (gzy & gxy)) {
-          continue;
-        }
-        bitset mask_z(_1 << z);
+        word & rgzx(g.gridzx[z]);
+        word & rgzy(g.gridzy[z]);
+        word gzx(rgzx);
+        word gzy(rgzy);
+        word mask_z(_1 << z);
         rgxz = gxz ^ mask_z;
         rgyz = gyz ^ mask_z;
         rgzx = gzx ^ mask_x;
@@ -534,48 +1648,48 @@ namespace {
           rgxz = gxz;
         });
         if(maj_z < sz && z == max_z) {
-          s.g0.max_rook_height = max_z + 1;
+          g.max_rook_height = max_z + 1;
           try {
             if(max_allowed_card_reached) {
-              backtrack_next_row(y);
+              backtrack_next_row(g,y);
             } else {
-              backtrack_next_pillar(x,y);
+              backtrack_next_pillar(g,x,y);
             }
           } catch(GetCallStackException & e) {
-            s.g0.max_rook_height = max_z;
+            g.max_rook_height = max_z;
             loop_undo();
             speculative_undo();
             if(consistency_check()) {
-              grid g2(s.g0);
+              grid g2(to_grid(g));
               auto job(new
                 grid_job_next_pillar(std::move(g2),x,y,s.optimum_so_far));
               e.call_stack.emplace_back(job);
             }
             throw;
           }
-          s.g0.max_rook_height = max_z;
+          g.max_rook_height = max_z;
           //we know we where on the last possible z.
           loop_undo();
           break;
         } else {
           try {
             if(max_allowed_card_reached) {
-              backtrack_next_row(y);
+              backtrack_next_row(g,y);
             } else {
-              backtrack_next_pillar(x,y);
+              backtrack_next_pillar(g,x,y);
             }
           } catch(GetCallStackException & e) {
             loop_undo();
             speculative_undo();
             if(guz == 0) {
               if(consistency_check()) {
-                grid g2(s.g0);
+                grid g2(to_grid(g));
                 auto job(new
                   grid_job_next_pillar(std::move(g2),x,y,s.optimum_so_far));
                 e.call_stack.emplace_back(job);
               }
             } else {
-              grid g2(s.g0);
+              grid g2(to_grid(g));
               auto job(new
                 grid_job_pillar(std::move(g2),x,y,z+1,s.optimum_so_far));
               e.call_stack.emplace_back(job);
@@ -588,31 +1702,31 @@ namespace {
       speculative_undo();
     }
     if(consistency_check()) {
-      backtrack_next_pillar(x,y);
+      backtrack_next_pillar(g,x,y);
     } else {
-      communicate();
+      communicate(g);
     }
   }
   
   /* We now that when we enter this function, the previous row
      is not filled up to full allowed cardinality. */
-  void grid_job_inter::backtrack_next_pillar(dims x,dims y) {
+  template<typename G>
+  void grid_job_inter::backtrack_next_pillar(G & g,dims x,dims y) {
     if(x == 0) {
-      //TODO:insert equilibrium code here.
       //Reached the end of the row with lower card,
       //so do some maintenance stuff
       //This stuff is only needed if the end of the row
       //is reached without max allowed cardinality.
-      dims lc(s.g0.last_card);
-      dims cc(s.g0.current_card);
-      s.g0.last_card = cc;
-      s.g0.current_card = 0;
+      dims lc(g.last_card);
+      dims cc(g.current_card);
+      g.last_card = cc;
+      g.current_card = 0;
       auto undo([&]() {
-        s.g0.current_card = cc;
-        s.g0.last_card = lc;
+        g.current_card = cc;
+        g.last_card = lc;
       });
       try {
-        backtrack_next_row(y);
+        backtrack_next_row(g,y);
       } catch(GetCallStackException &) {
         undo();
         throw;
@@ -620,29 +1734,720 @@ namespace {
       undo();
     } else {
       //direct recursion.
-      backtrack_pillar(x-1,y,0);
+      backtrack_pillar(g,x-1,y,0);
     }
   }
   
-  void grid_job_inter::backtrack_next_row(dims y) {
+  template<typename G>
+  void grid_job_inter::backtrack_next_row(G & g,dims y) {
     if(y == 0) {
-      communicate();
-      int candidate = s.g0.rooks;
-      if(candidate > s.optimum_so_far) {
-        s.optimum_so_far = candidate;
-        grid_signal gs;
-        gs.signal_type = optimum_code;
-        gs.found_optimum = s.optimum_so_far;
-        auto gr = new grid(s.g0);
-        gs.best_grid = std::unique_ptr<grid,grid_deleter>(gr);
-        _q.query(&gs);
-        _q.wait_answer();
+      signal_leaf(g);
+      //Only after signalling: a GetCallStackException thrown from here
+      //would lose the leaf.
+      communicate(g);
+    } else if(_prefixes != nullptr && g.size - y == _prefix_rows) {
+      _prefixes->emplace_back(new
+        grid_job_pillar(to_grid(g),g.size-1,y-1,0,s.optimum_so_far));
+    } else if(_table == nullptr || _counts != nullptr || y < table_rows) {
+      //(Stored bounds only hold for grids that do not beat the optimum.)
+      backtrack_pillar(g,g.size-1,y-1,0);
+    } else {
+      /* The rows left have been searched before from another grid with
+         the same key: they can not add more than the bound stored then.
+         A bound is stored only once the rows are searched to the end
+         here (not when the call stack is given away). Every grid adding
+         more than optimum_so_far - rooks is found by the search, so
+         that is the bound. */
+      table_key k(row_key(g,y));
+      int bound;
+      ++_table_probes;
+      if(_table->probe(k,bound) && g.rooks + bound <= s.optimum_so_far) {
+        ++_table_hits;
+        communicate(g);
+        return;
       }
+      backtrack_pillar(g,g.size-1,y-1,0);
+      _table->store(k,s.optimum_so_far - g.rooks);
+    }
+  }
+  
+  grid_job_stack::grid_job_stack(grid && g,
+                                 dims x,
+                                 dims y,
+                                 dims z,
+                                 bool n,
+                                 int opt) :
+    grid_job_inter(std::move(g),opt),xstart(x),ystart(y),zstart(z),next(n),
+    frames(NULL),depth(0) {}
+  
+  //Same formats as grid_job_next_pillar and grid_job_pillar.
+  void grid_job_stack::serialize(std::string & buf) {
+    put_u8(buf,static_cast<uint8_t>(xstart));
+    put_u8(buf,static_cast<uint8_t>(ystart));
+    if(!next) { put_u8(buf,static_cast<uint8_t>(zstart)); }
+    put_i32(buf,s.optimum_so_far);
+    grid_job::serialize(s.g0,buf);
+  }
+  
+  const std::string & grid_job_stack::get_job_id() {
+    return(next ? grid_job_stack_next_pillar_name : grid_job_stack_pillar_name);
+  }
+  
+  void grid_job_stack::minorate_optimum(int minopt) {
+    if(minopt > s.optimum_so_far) { s.optimum_so_far = minopt; }
+  }
+
+  int grid_job_stack::upper_bound() const {
+    return(row_bound(next ? xstart : xstart + 1,ystart));
+  }
+  
+  grid_job_stack *
+    grid_job_stack_id::deserialize(const std::string & s,size_t l,size_t u) {
+    dims c[3] = { 0,0,0 };
+    int opt;
+    std::unique_ptr<grid> g(deserialize_job(s,l,u,next ? 2 : 3,c,opt));
+    if(g == nullptr) { return(NULL); }
+    return(new grid_job_stack(std::move(*g),c[0],c[1],c[2],next,opt));
+  }
+  
+  void grid_job_stack::run() {
+    depth = 0;
+    size_dispatch<max_fixed_size>::search(*this,s.g0);
+  }
+  
+  template<typename G>
+  void grid_job_stack::search(G & g) {
+    //A path of the search puts at most one rook per pillar.
+    std::vector< stack_frame<typename G::word> >
+      fs(static_cast<size_t>(g.size) * g.size);
+    frames = fs.data();
+    if(next) {
+      descend(g,xstart,ystart);
     } else {
-      backtrack_pillar(s.g0.size-1,y-1,0);
+      enter(g,xstart,ystart,zstart);
+    }
+    //Stopping on a query empties the stack.
+    while(depth != 0) {
+      step(g);
+    }
+    frames = NULL;
+  }
+  
+  template<typename G>
+  inline bool grid_job_stack::advance(G & g,dims & x,dims & y) {
+    if(x != 0) {
+      --x;
+      return true;
+    }
+    //End of the row. Frames restore the cardinals.
+    g.last_card = g.current_card;
+    g.current_card = 0;
+    if(y == 0) { return false; }
+    x = g.size-1;
+    --y;
+    return true;
+  }
+  
+  template<typename G>
+  inline void grid_job_stack::descend(G & g,dims x,dims y) {
+    if(advance(g,x,y)) {
+      enter(g,x,y,0);
+    } else {
+      signal_leaf(g);
+      answer_queries(g);
+    }
+  }
+  
+  template<typename G>
+  inline void grid_job_stack::enter(G & g,dims x,dims y,dims z0) {
+    typedef typename G::word word;
+    word _1(1);
+    //Go through pillars that can only stay empty.
+    while(true) {
+      ++_nodes;
+      PROFILE_COUNT(_profile,nodes[y]);
+      word gxz(g.gridxz[x]);
+      word gyz(g.gridyz[y]);
+      if(!(gxz & gyz)) {
+        dims cc(g.current_card);
+        word gyx(g.gridyx[y]);
+        word ugyx(gyx ^ (_1 << x));
+        bool max_reached(cc + 1 == g.last_card);
+        if(!max_reached || ugyx >= g.gridyx[y+1]) {
+          stack_frame<word> & f(frame<word>(depth++));
+          f.x = x;
+          f.y = y;
+          f.cc = cc;
+          f.lc = g.last_card;
+          f.max_z = g.max_rook_height;
+          f.rooks = g.rooks;
+          f.gxy = g.gridxy[x];
+          f.gyx = gyx;
+          f.gxz = gxz;
+          f.gyz = gyz;
+          f.max_reached = max_reached;
+          f.placed = false;
+          f.skip = true;
+          /* Speculative updates, kept for every height. */
+          g.gridxy[x] = f.gxy ^ (_1 << y);
+          g.gridyx[y] = ugyx;
+          g.rooks = f.rooks + 1;
+          word free_z((~(gxz | gyz)) &
+                      (((_1 << f.max_z) << 1) - 1) &
+                      ~((_1 << z0) - 1));
+          f.guz = viable_heights(g,free_z,gyx,f.gxy);
+          if(f.guz == 0 && free_z != 0) {
+            PROFILE_COUNT(_profile,attack_cuts[y]);
+          }
+          return;
+        }
+        //No filling of this row can be ordered anymore,
+        //see backtrack_pillar.
+        x = 0;
+      } else {
+        //Double attack on the pillar, which can only stay empty.
+        PROFILE_COUNT(_profile,attack_cuts[y]);
+        if(!worth_skipping(g,x,y,g.gridxy[x],s.optimum_so_far,_bound,
+                           _profile)) {
+          answer_queries(g);
+          return;
+        }
+      }
+      if(!advance(g,x,y)) {
+        signal_leaf(g);
+        answer_queries(g);
+        return;
+      }
+      z0 = 0;
+    }
+  }
+  
+  template<typename G>
+  inline void grid_job_stack::step(G & g) {
+    typedef typename G::word word;
+    stack_frame<word> & f(frame<word>(depth-1));
+    dims x(f.x);
+    dims y(f.y);
+    if(f.placed) {
+      g.gridzy[f.z] = f.gzy;
+      g.gridzx[f.z] = f.gzx;
+      g.gridyz[y] = f.gyz;
+      g.gridxz[x] = f.gxz;
+      g.max_rook_height = f.max_z;
+      f.placed = false;
+    }
+    word _1(1);
+    while(f.guz != 0) {
+      dims z(FFS_BITSET(0,f.guz) - 1);
+      f.guz &= f.guz - 1;
+      word gzx(g.gridzx[z]);
+      word gzy(g.gridzy[z]);
+      word mask_z(_1 << z);
+      g.gridxz[x] = f.gxz ^ mask_z;
+      g.gridyz[y] = f.gyz ^ mask_z;
+      g.gridzx[z] = gzx ^ (_1 << x);
+      g.gridzy[z] = gzy ^ (_1 << y);
+      f.z = z;
+      f.gzx = gzx;
+      f.gzy = gzy;
+      f.placed = true;
+      //Highest allowed height: the next rook may go one floor higher.
+      if(f.max_z + 1 < g.size && z == f.max_z) {
+        g.max_rook_height = f.max_z + 1;
+      }
+      g.last_card = f.lc;
+      g.current_card = f.cc + 1;
+      descend(g,f.max_reached ? 0 : x,y);
+      return;
+    }
+    //Back to the entry state, then leave the pillar empty. That is the
+    //last alternative: the frame is not needed anymore.
+    g.gridxy[x] = f.gxy;
+    g.gridyx[y] = f.gyx;
+    g.rooks = f.rooks;
+    g.current_card = f.cc;
+    g.last_card = f.lc;
+    bool skip(f.skip &&
+              worth_skipping(g,x,y,f.gxy,s.optimum_so_far,_bound,_profile));
+    --depth;
+    if(skip) {
+      descend(g,x,y);
+    } else {
+      answer_queries(g);
+    }
+  }
+  
+  template<typename W>
+  void grid_job_stack::undo_frame(grid & g,size_t d) const {
+    const stack_frame<W> & f(frame<W>(d));
+    if(f.placed) {
+      g.gridzy[f.z] = word_cast<bitset>(f.gzy);
+      g.gridzx[f.z] = word_cast<bitset>(f.gzx);
+    }
+    g.gridxy[f.x] = word_cast<bitset>(f.gxy);
+    g.gridyx[f.y] = word_cast<bitset>(f.gyx);
+    g.gridxz[f.x] = word_cast<bitset>(f.gxz);
+    g.gridyz[f.y] = word_cast<bitset>(f.gyz);
+    g.rooks = f.rooks;
+    g.current_card = f.cc;
+    g.last_card = f.lc;
+    g.max_rook_height = f.max_z;
+  }
+  
+  template<typename W>
+  grid_job_stack * grid_job_stack::alternatives(grid && g,size_t d) {
+    stack_frame<W> & f(frame<W>(d));
+    if(f.guz != 0) {
+      //A rook is on the pillar (at height z), backtrack_pillar from the
+      //next height covers the other heights and the empty pillar.
+      f.guz = 0;
+      f.skip = false;
+      return(new grid_job_stack(std::move(g),f.x,f.y,f.z+1,false,
+                                s.optimum_so_far));
+    }
+    if(f.skip) {
+      f.skip = false;
+      if(worth_skipping(g,f.x,f.y,word_cast<bitset>(f.gxy),
+                        s.optimum_so_far,_bound,nullptr)) {
+        return(new grid_job_stack(std::move(g),f.x,f.y,0,true,
+                                  s.optimum_so_far));
+      }
+    }
+    return(NULL);
+  }
+  
+  template<typename G>
+  bool grid_job_stack::split(const G & g,
+                             std::vector< std::unique_ptr< grid_job > > & rt) {
+    typedef typename G::word word;
+    for(size_t d(0);d != depth;++d) {
+      const stack_frame<word> & f(frame<word>(d));
+      if(f.guz == 0 && !f.skip) { continue; }
+      grid c(to_grid(g));
+      for(size_t k(depth);k != d;--k) {
+        undo_frame<word>(c,k-1);
+      }
+      grid_job_stack * job(alternatives<word>(std::move(c),d));
+      if(job != NULL) {
+        rt.emplace_back(job);
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  template<typename G>
+  void grid_job_stack::give_all(const G & g,
+                                std::vector< std::unique_ptr< grid_job > > & rt) {
+    typedef typename G::word word;
+    //Deepest first, as the recursive jobs do.
+    grid c(to_grid(g));
+    for(size_t k(depth);k != 0;--k) {
+      undo_frame<word>(c,k-1);
+      const stack_frame<word> & f(frame<word>(k-1));
+      if(f.guz == 0 && !f.skip) { continue; }
+      grid g2(c);
+      grid_job_stack * job(alternatives<word>(std::move(g2),k-1));
+      if(job != NULL) { rt.emplace_back(job); }
+    }
+  }
+  
+  template<typename G>
+  inline void grid_job_stack::answer_queries(const G & g) {
+    if(_a.have_query()) {
+      auto qr(_a.get_query());
+      switch(qr->query_type) {
+      case monitor_code: {
+        qr->monitor_grid =
+          std::unique_ptr<grid,grid_deleter>(new grid(to_grid(g)));
+        if(_profile != nullptr) { _profile->report(qr->profile); }
+        _a.answer();
+        return; }
+      case split_code: {
+        if(split(g,qr->jobs)) {
+          qr->still_working = true;
+          _a.answer();
+          return;
+        }
+        //Nothing left but the path being explored, which is done.
+        qr->still_working = false;
+        depth = 0;
+        _end = job_end_given;
+        return; }
+      case get_jobs_code: {
+        give_all(g,qr->jobs);
+        qr->still_working = false;
+        depth = 0;
+        _end = job_end_given;
+        return; }
+      case kill_code: {
+        _a.answer();
+        depth = 0;
+        _end = job_end_killed;
+        return; }
+      case register_code: {
+        int proposal = qr->new_optimum;
+        if(proposal > s.optimum_so_far) { s.optimum_so_far = proposal; }
+        _a.answer();
+        return; }
+      case go_to_work_code: {
+        //Erroneous situation. Blindly terminates the process.
+        std::terminate();
+        break; }
+      }
+    }
+  }
+  
+  grid_job_floor::grid_job_floor(grid && g,
+                                 const floor_state & f,
+                                 floor_step st,
+                                 dims oldxd,
+                                 dims xc,
+                                 dims yc,
+                                 int opt) :
+    grid_job_inter(std::move(g),opt),fstart(f),step(st),oldxdstart(oldxd),
+    xstart(xc),ystart(yc) {}
+  
+  //Arguments (oldxd, xc, yc) used by each step.
+  const bool floor_step_args[5][3] = {
+    { false,false,false },
+    { false,false,false },
+    { true,true,true },
+    { true,false,true },
+    { true,true,false }
+  };
+  
+  /* Job format: the arguments the step uses (oldxd, xc, yc), xd, yd, lv,
+     xs, ys, optimum_so_far (32 bits), then the grid. */
+  void grid_job_floor::serialize(std::string & buf) {
+    const dims args[3] = { oldxdstart,xstart,ystart };
+    for(int i(0);i != 3;++i) {
+      if(floor_step_args[step][i]) {
+        put_u8(buf,static_cast<uint8_t>(args[i]));
+      }
+    }
+    put_u8(buf,static_cast<uint8_t>(fstart.xd));
+    put_u8(buf,static_cast<uint8_t>(fstart.yd));
+    put_u8(buf,static_cast<uint8_t>(fstart.lv));
+    put_u8(buf,static_cast<uint8_t>(fstart.xs));
+    put_u8(buf,static_cast<uint8_t>(fstart.ys));
+    put_i32(buf,s.optimum_so_far);
+    grid_job::serialize(s.g0,buf);
+  }
+  
+  const std::string & grid_job_floor::get_job_id() {
+    return(grid_job_floor_names[step]);
+  }
+  
+  void grid_job_floor::minorate_optimum(int minopt) {
+    if(minopt > s.optimum_so_far) { s.optimum_so_far = minopt; }
+  }
+  
+  grid_job_floor *
+    grid_job_floor_id::deserialize(const std::string & s,size_t l,size_t u) {
+    serial_reader r(s,l,u);
+    dims args[3] = { 0,0,0 };
+    for(int i(0);i != 3;++i) {
+      if(floor_step_args[step][i] && !r.get_i8(args[i])) { return(NULL); }
+    }
+    floor_state f;
+    int32_t opt;
+    if(!r.get_i8(f.xd) || !r.get_i8(f.yd) || !r.get_i8(f.lv) ||
+       !r.get_i8(f.xs) || !r.get_i8(f.ys) || !r.get_i32(opt)) {
+      return(NULL);
+    }
+    std::unique_ptr<grid> g(grid_job::deserialize(s,r.pos(),r.end()));
+    if(g == nullptr) { return(NULL); }
+    dims len(g->size);
+    //The loops of the steps stop on equality: keep their arguments
+    //in range.
+    if(f.xd < 0 || f.xd > len || f.yd < 0 || f.yd > len ||
+       f.lv < 0 || f.lv >= len || f.xs < 0 || f.xs >= len ||
+       f.ys < 0 || f.ys >= len ||
+       args[0] < 0 || args[0] > f.xd || args[1] < 0 || args[2] < 0 ||
+       (step == floor_next_x && (args[1] >= f.xd || args[2] >= f.yd)) ||
+       (step == floor_next_y && args[2] >= f.yd) ||
+       (step == floor_left_wing && args[1] > args[0])) {
+      return(NULL);
+    }
+    return(new grid_job_floor(std::move(*g),f,step,args[0],args[1],args[2],
+                              opt));
+  }
+  
+  void grid_job_floor::run() {
+    if(s.g0.size <= 16) {
+      floor_grid<uint16_t> g(s.g0,fstart);
+      search(g);
+    } else if(s.g0.size <= 32) {
+      floor_grid<uint32_t> g(s.g0,fstart);
+      search(g);
+    } else if(s.g0.size <= 64) {
+      floor_grid<uint64_t> g(s.g0,fstart);
+      search(g);
+    } else {
+      floor_grid<bitset> g(s.g0,fstart);
+      search(g);
+    }
+  }
+  
+  template<typename W>
+  void grid_job_floor::search(floor_grid<W> & g) {
+    switch(step) {
+    case floor_corner:
+      backtrack_corner(g);
+      break;
+    case floor_next_lv:
+      backtrack_next_lv(g);
+      break;
+    case floor_next_x:
+      backtrack_next_x(g,oldxdstart,xstart,ystart);
+      break;
+    case floor_next_y:
+      backtrack_next_y(g,oldxdstart,ystart);
+      break;
+    case floor_left_wing:
+      backtrack_left_wing(g,oldxdstart,xstart);
+      break;
+    }
+  }
+  
+  template<typename W>
+  inline void grid_job_floor::add_rook(floor_grid<W> & g,dims x,dims y,
+                                       W & sx,W & sy) {
+    ++_nodes;
+    dims lv(g.f.lv);
+    PROFILE_COUNT(_profile,nodes[lv]);
+    W _1(1);
+    W bx(_1 << x);
+    W by(_1 << y);
+    W bl(_1 << lv);
+    if(g.gridzx[lv] == 0) {
+      g.f.xs = x;
+      g.f.ys = y;
+    }
+    ++g.rooks;
+    g.gridxy[x] |= by;
+    g.gridyx[y] |= bx;
+    g.gridxz[x] |= bl;
+    g.gridyz[y] |= bl;
+    g.gridzx[lv] |= bx;
+    g.gridzy[lv] |= by;
+    sx = g.splitx;
+    sy = g.splity;
+    g.splitx = sx | g.gridyx[y];
+    g.splity = sy | g.gridxy[x];
+  }
+  
+  //xs and ys stay: they are only read once the floor has a rook again.
+  template<typename W>
+  inline void grid_job_floor::rm_rook(floor_grid<W> & g,dims x,dims y,
+                                      W sx,W sy) {
+    dims lv(g.f.lv);
+    W _1(1);
+    W bx(_1 << x);
+    W by(_1 << y);
+    W bl(_1 << lv);
+    --g.rooks;
+    g.gridxy[x] ^= by;
+    g.gridyx[y] ^= bx;
+    g.gridxz[x] ^= bl;
+    g.gridyz[y] ^= bl;
+    g.gridzx[lv] ^= bx;
+    g.gridzy[lv] ^= by;
+    g.splitx = sx;
+    g.splity = sy;
+  }
+  
+  template<typename W>
+  void grid_job_floor::give(const floor_grid<W> & g,
+                            floor_step st,
+                            dims oldxd,
+                            dims xc,
+                            dims yc,
+                            std::vector< std::unique_ptr< grid_job > > & js) {
+    grid g2(to_grid(g));
+    js.emplace_back(new grid_job_floor(std::move(g2),g.f,st,oldxd,xc,yc,
+                                       s.optimum_so_far));
+  }
+  
+  //Start to fill a line from xc/yc (the frozen block is not empty).
+  template<typename W>
+  void grid_job_floor::backtrack_start_line(floor_grid<W> & g,
+                                            dims oldxd,
+                                            dims xc,
+                                            dims yc) {
+    if(g.splity & (W(1) << yc)) {
+      backtrack_next_y(g,oldxd,yc);
+    } else {
+      backtrack_inside(g,oldxd,xc,yc);
+    }
+  }
+  
+  //Try to fill a given cell inside the frozen block.
+  template<typename W>
+  void grid_job_floor::backtrack_inside(floor_grid<W> & g,
+                                        dims oldxd,
+                                        dims xc,
+                                        dims yc) {
+    W _1(1);
+    if(!(g.splitx & (_1 << xc)) && !(g.gridxy[xc] & (_1 << yc)) &&
+       !(g.gridxz[xc] & g.gridyz[yc])) {
+      W sx;
+      W sy;
+      add_rook(g,xc,yc,sx,sy);
+      try {
+        //The rest of the line is forbidden now.
+        backtrack_next_y(g,oldxd,yc);
+      } catch(GetCallStackException & e) {
+        rm_rook(g,xc,yc,sx,sy);
+        give(g,floor_next_x,oldxd,xc,yc,e.call_stack);
+        throw;
+      }
+      rm_rook(g,xc,yc,sx,sy);
+    }
+    backtrack_next_x(g,oldxd,xc,yc);
+  }
+  
+  /* Try the next cell of the line. Past the block, a rook may extend it
+     by a column (right wing): filling in lexicographic order, that is
+     the time to do so. No line there is forbidden yet. */
+  template<typename W>
+  void grid_job_floor::backtrack_next_x(floor_grid<W> & g,
+                                        dims oldxd,
+                                        dims xc,
+                                        dims yc) {
+    ++xc;
+    dims xd0(g.f.xd);
+    if(xc == xd0) {
+      if(xd0 != g.size) {
+        W sx;
+        W sy;
+        g.f.xd = xd0 + 1;
+        add_rook(g,xd0,yc,sx,sy);
+        try {
+          backtrack_next_y(g,oldxd,yc);
+        } catch(GetCallStackException & e) {
+          rm_rook(g,xd0,yc,sx,sy);
+          g.f.xd = xd0;
+          give(g,floor_next_y,oldxd,0,yc,e.call_stack);
+          throw;
+        }
+        rm_rook(g,xd0,yc,sx,sy);
+        g.f.xd = xd0;
+      }
+      backtrack_next_y(g,oldxd,yc);
+    } else {
+      backtrack_inside(g,oldxd,xc,yc);
+    }
+  }
+  
+  template<typename W>
+  void grid_job_floor::backtrack_next_y(floor_grid<W> & g,dims oldxd,dims yc) {
+    ++yc;
+    if(yc == g.f.yd) {
+      backtrack_left_wing(g,oldxd,0);
+    } else {
+      backtrack_start_line(g,oldxd,0,yc);
+    }
+  }
+  
+  /* Extend the block by a row (left wing), with rooks in increasing
+     columns from xc, left of oldxd: the row has no rook, so only the
+     floor may forbid a column. */
+  template<typename W>
+  void grid_job_floor::backtrack_left_wing(floor_grid<W> & g,
+                                           dims oldxd,
+                                           dims xc) {
+    dims yd0(g.f.yd);
+    if(yd0 != g.size) {
+      W _1(1);
+      g.f.yd = yd0 + 1;
+      for(dims x(xc);x != oldxd;++x) {
+        if(!(g.splitx & (_1 << x))) {
+          W sx;
+          W sy;
+          add_rook(g,x,yd0,sx,sy);
+          try {
+            backtrack_left_wing(g,oldxd,x+1);
+          } catch(GetCallStackException & e) {
+            rm_rook(g,x,yd0,sx,sy);
+            g.f.yd = yd0;
+            //The rest of the loop, then the corner.
+            give(g,floor_left_wing,oldxd,x+1,0,e.call_stack);
+            throw;
+          }
+          rm_rook(g,x,yd0,sx,sy);
+        }
+      }
+      g.f.yd = yd0;
+      backtrack_corner(g);
+    } else {
+      backtrack_next_lv(g);
+    }
+  }
+  
+  //Extend the block by the cell past its corner.
+  template<typename W>
+  void grid_job_floor::backtrack_corner(floor_grid<W> & g) {
+    dims xd0(g.f.xd);
+    dims yd0(g.f.yd);
+    if(xd0 != g.size && yd0 != g.size) {
+      W sx;
+      W sy;
+      g.f.xd = xd0 + 1;
+      g.f.yd = yd0 + 1;
+      add_rook(g,xd0,yd0,sx,sy);
+      auto undo([&]() {
+        rm_rook(g,xd0,yd0,sx,sy);
+        g.f.xd = xd0;
+        g.f.yd = yd0;
+      });
+      try {
+        backtrack_corner(g);
+      } catch(GetCallStackException & e) {
+        undo();
+        give(g,floor_next_lv,0,0,0,e.call_stack);
+        throw;
+      }
+      undo();
+    }
+    backtrack_next_lv(g);
+  }
+  
+  /* Go to the next floor, starting from the first rook of this one.
+     Floors are never left empty (not even the last ones). */
+  template<typename W>
+  void grid_job_floor::backtrack_next_lv(floor_grid<W> & g) {
+    dims lv(g.f.lv);
+    if(g.gridzx[lv] == 0) {
+      communicate(g);
+    } else if(lv + 1 == g.size) {
+      signal_leaf(g);
+      //Only after signalling (see backtrack_next_row).
+      communicate(g);
+    } else {
+      dims xs0(g.f.xs);
+      dims ys0(g.f.ys);
+      W sx(g.splitx);
+      W sy(g.splity);
+      g.f.lv = lv + 1;
+      g.splitx = 0;
+      g.splity = 0;
+      auto undo([&]() {
+        g.f.lv = lv;
+        g.f.xs = xs0;
+        g.f.ys = ys0;
+        g.splitx = sx;
+        g.splity = sy;
+      });
+      try {
+        backtrack_start_line(g,g.f.xd,xs0,ys0);
+      } catch(GetCallStackException &) {
+        undo();
+        throw;
+      }
+      undo();
     }
   }
   
 }
-
-
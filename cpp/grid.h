@@ -6,12 +6,19 @@
 #include <memory>
 #include <tuple>
 #include <iostream>
+#include <atomic>
+#include <cinttypes>
+#include <map>
+#include <string>
 #include "query.h"
 #include "bitset.h"
 #include "job.h"
 
 class grid_job;
+class transposition_table;
 struct grid;
+//Largest grid size: row cardinals go up to size+1, in a dims.
+const dims max_grid_size = 126;
 //Required since we do not provide grid implementation.
 struct grid_deleter {
   void operator()(grid *) const;
@@ -25,6 +32,9 @@ enum grid_query_code {
   monitor_code,
   //Query: get current job queue
   get_jobs_code,
+  //Query: get part of the current job queue. The worker may keep on
+  //working on the rest (see still_working).
+  split_code,
   //Query: kill backtracking thread.
   kill_code,
   //Query: register potentially "new" optimum
@@ -41,6 +51,35 @@ enum grid_signal_code {
   job_done_code,
 };
 
+/* Search events of a worker, by row (rows are filled from size-1 down
+   to 0), or by floor for grid_engine_floor (nodes only), counted only if
+   grid.cpp is built with SEARCH_PROFILE.
+   Sent back with monitor_code answers. */
+struct grid_profile {
+  grid_profile();
+  //Copy to r, with the rate since the previous report of this profile.
+  void report(grid_profile & r);
+  //Pillars tried (search nodes).
+  uint64_t nodes[max_grid_size];
+  //Empty pillars cut by the bounds (rooks left in rows, capacities).
+  uint64_t bound_cuts[max_grid_size];
+  //Empty pillars cut by the binary order of columns.
+  uint64_t order_cuts[max_grid_size];
+  //Pillars where double attacks leave no height for a rook.
+  uint64_t attack_cuts[max_grid_size];
+  //Complete grids reached, and those better than the optimum then.
+  uint64_t leaves;
+  uint64_t optima;
+  //Is the profile counted at all ?
+  bool enabled;
+  //Nodes per second between the two last reports (or since the profile
+  //was made).
+  double rate;
+  //When the last report was made (seconds), and its nodes.
+  double reported_time;
+  uint64_t reported_nodes;
+};
+
 struct grid_query {
   //query code
   grid_query_code query_type;
@@ -48,10 +87,55 @@ struct grid_query {
   std::unique_ptr<grid,grid_deleter> monitor_grid;
   //return space for job queue.
   std::vector< std::unique_ptr < grid_job > > jobs;
+  //Is the worker still running a job after answering split_code ?
+  bool still_working;
   //optimum to register.
   int new_optimum;
   //Job on which to start work.
   std::unique_ptr< grid_job > start_job;
+  //Return space for the worker profile (with monitor_grid).
+  grid_profile profile;
+};
+
+/* Best optimum known by every worker of a search, shared through memory
+   rather than register_code messages. Raised with a CAS by the job that
+   finds a better grid, read by every job while pruning.
+   Alone in its cache line: it is read on nearly every node.
+   Note: do not allocate it with new (over-aligned). */
+struct alignas(64) shared_bound {
+  inline explicit shared_bound(int v) : value(v) {}
+  shared_bound(const shared_bound &) = delete;
+  shared_bound & operator=(const shared_bound &) = delete;
+  inline int get() const { return value.load(std::memory_order_relaxed); }
+  //Raise the bound to v (if it is better).
+  inline void raise(int v) {
+    int cur(value.load(std::memory_order_relaxed));
+    while(cur < v &&
+          !value.compare_exchange_weak(cur,v,std::memory_order_relaxed)) {}
+  }
+  std::atomic<int> value;
+};
+
+/* Optimal grids counted by a search (counting mode). A counting job
+   looks for no better grid: every complete grid with more rooks than
+   its optimum (set to the optimum - 1) is counted instead, by the
+   worker running it. */
+struct grid_counts {
+  inline grid_counts() : kept(0),orbits(false),by_permutations() {}
+  //Add the counts of another worker.
+  void merge(const grid_counts &);
+  //Number of grids of size size in the classes of the kept grids, in
+  //decimal (orbits must be set).
+  std::string all(dims size) const;
+  //Grids kept by the engine (its symmetry breaking keeps one grid or
+  //more per class of grids equal up to permutations of x, y and z).
+  uint64_t kept;
+  //Also count the grids of their classes. Only without grid_symmetry
+  //rules.
+  bool orbits;
+  //Kept grids by the number of permutations of x, y and z under which
+  //they are kept (needs orbits).
+  std::map<uint64_t,uint64_t> by_permutations;
 };
 
 struct grid_signal {
@@ -62,13 +146,51 @@ struct grid_signal {
   int found_optimum;
 };
 
+//Search engines for the grid problem (families of grid jobs).
+enum grid_engine {
+  //Recursive backtracking. Splits by unwinding its whole call stack.
+  grid_engine_recursive,
+  //Backtracking over an explicit stack of frames. Splits by giving away
+  //its shallowest untried alternatives, and keeps on working.
+  grid_engine_stack,
+  //Floor by floor backtracking of rooks.c, rows and columns ordered by a
+  //growing frozen block. Splits like grid_engine_recursive. Has its own
+  //symmetry breaking (grid_symmetry flags are ignored), and does not
+  //prune with the optimum.
+  grid_engine_floor
+};
+
+/* Symmetry breaking rules that can be added to the default ones (flags).
+   The three axis play the same role, so rows can be taken along an axis
+   whose planes hold the most rooks. */
+enum grid_symmetry {
+  //No column nor floor holds more rooks than the first row.
+  grid_symmetry_cards = 1,
+  //With grid_symmetry_cards only: once the rows holding as many rooks as
+  //the first one are known, no more columns nor floors than them hold
+  //that many.
+  grid_symmetry_equilibrium = 2
+};
+
+//How the run of a grid job ended.
+enum grid_job_end {
+  //Search done.
+  job_end_done,
+  //Remaining search given away, answer expected from the worker.
+  job_end_given,
+  //kill_code received (and answered).
+  job_end_killed
+};
+
 class grid_job : public job {
 public:
   //Get the job identifiers for grid jobs.
   static std::vector< std::unique_ptr< job_id > > get_ids();
   //Create a (communication structures un-initialized)
   //grid job for fixed size.
-  static grid_job * make(dims size,int initial_guess);
+  //grid_symmetry flags.
+  static grid_job * make(dims size,int initial_guess,grid_engine engine,
+                         int symmetry);
   //Grid inspection.
   static dims size(const grid &);
   static bool have_rook(const grid &,dims x,dims y,dims z);
@@ -80,24 +202,73 @@ public:
   static int rook_x(const grid &,dims y,dims z);
   static void print(const grid &,std::ostream &);
   static grid * make_copy(const grid &);
+  //Grid of the given size holding the given rooks (x, y, z), with no
+  //search state (as a best grid only). The rooks are not checked.
+  static grid * make_grid(dims size,
+                          const std::vector<std::tuple<dims,dims,dims> > &);
+  //Does the grid hold at most one rook per line, and no empty cell
+  //attacked along the three axis ?
+  static bool is_valid(const grid &);
   //Grid serialization by appending to the given string.
   static void serialize(const grid &,std::string &);
-  //Grid deserialization.
-  static grid * deserialize(std::string &,size_t,size_t);
+  //Grid deserialization (between bounds in the string).
+  //NULL if the data is malformed.
+  static grid * deserialize(const std::string &,size_t,size_t);
   //Initialize communication structures. Should be done only once.
   inline void initialize_comm(answer_side<grid_query> a,
                               query_side<grid_signal> q) {
     _a = a;
     _q = q;
   }
+  //Prune with (and raise) the given bound as well, if not null.
+  inline void share_bound(shared_bound * b) { _bound = b; }
+  //Skip subproblems already solved, through the given table if not null.
+  inline void share_table(transposition_table * t) { _table = t; }
+  //Count optimal grids into the given counts if not null (counting
+  //mode), instead of signalling better grids.
+  inline void share_counts(grid_counts * c) { _counts = c; }
+  //Count search events into the given profile if not null.
+  inline void share_profile(grid_profile * p) { _profile = p; }
+  /* Run a recursive engine job on the calling thread, up to the grids
+     whose first rows rows (from the top) are complete and pass the row
+     rules. Every such grid goes to out as a job searching the rows left,
+     instead of being searched. rows must leave a row to search below the
+     job's start. The job can be run again afterwards. */
+  static void expand(grid_job & j,
+                     dims rows,
+                     std::vector< std::unique_ptr<grid_job> > & out);
   //Give an estimate of the optimum that may ameliorate the one known by
   //the job.
   virtual void minorate_optimum(int minopt) = 0;
+  //Most rooks a grid found by the job may hold, from the row bound of
+  //the search (as it prunes), or INT_MAX if the engine has none.
+  virtual int upper_bound() const;
+  //Number of search nodes explored by the job so far.
+  inline uint64_t nodes() const { return _nodes; }
+  //Transposition table probes of the job so far, and those that hit.
+  inline uint64_t table_probes() const { return _table_probes; }
+  inline uint64_t table_hits() const { return _table_hits; }
+  //How run() ended. Jobs that stop by throwing always report
+  //job_end_done.
+  inline grid_job_end end() const { return _end; }
   //This is abstract (v-methods not implemented).
 protected:
-  inline grid_job() : _a(),_q() {}
+  inline grid_job() : _a(),_q(),_bound(nullptr),_table(nullptr),
+    _counts(nullptr),_profile(nullptr),_prefixes(nullptr),_prefix_rows(0),
+    _nodes(0),_table_probes(0),_table_hits(0),_end(job_end_done) {}
   answer_side<grid_query> _a;
   query_side<grid_signal> _q;
+  shared_bound * _bound;
+  transposition_table * _table;
+  grid_counts * _counts;
+  grid_profile * _profile;
+  //Given grids, while expanding (see expand).
+  std::vector< std::unique_ptr<grid_job> > * _prefixes;
+  dims _prefix_rows;
+  uint64_t _nodes;
+  uint64_t _table_probes;
+  uint64_t _table_hits;
+  grid_job_end _end;
 };
 
 //Worker for grid jobs.
@@ -108,12 +279,37 @@ public:
   grid_worker(grid_worker &&) = delete;
   grid_worker operator=(const grid_worker &) = delete;
   grid_worker operator=(grid_worker &&) = delete;
-  inline grid_worker(answer_side<grid_query> a,query_side<grid_signal> q) :
-    _a(a),_q(q) {}
+  inline grid_worker(answer_side<grid_query> a,
+                     query_side<grid_signal> q,
+                     shared_bound * b = nullptr,
+                     transposition_table * t = nullptr,
+                     grid_counts * c = nullptr) :
+    _a(a),_q(q),_bound(b),_table(t),_counts(c),_profile(),_nodes(0),
+    _table_probes(0),_table_hits(0) {}
   void run();
+  //Search nodes explored by every job the worker ran.
+  //To be read once the worker is done.
+  inline uint64_t nodes() const { return _nodes; }
+  //Same for transposition table probes and hits.
+  inline uint64_t table_probes() const { return _table_probes; }
+  inline uint64_t table_hits() const { return _table_hits; }
 protected:
+  //Add the counters of a job that ran.
+  inline void count(const grid_job & j) {
+    _nodes += j.nodes();
+    _table_probes += j.table_probes();
+    _table_hits += j.table_hits();
+  }
   answer_side<grid_query> _a;
   query_side<grid_signal> _q;
+  shared_bound * _bound;
+  transposition_table * _table;
+  grid_counts * _counts;
+  //Counted by every job the worker runs.
+  grid_profile _profile;
+  uint64_t _nodes;
+  uint64_t _table_probes;
+  uint64_t _table_hits;
 };
 
 #endif
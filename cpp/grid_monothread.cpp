@@ -1,29 +1,58 @@
 
 #include "grid_monothread.h"
+#include "transposition.h"
 #include <thread>
 #include <chrono>
+#include <memory>
 
-grid_monothread::grid_monothread() : _gqe(),_gse() {}
+grid_monothread::grid_monothread() : _nodes(0),_table_bytes(0),
+  _table_probes(0),_table_hits(0),_counting(false),_counts(),
+  _gqe(),_gse() {}
 
 grid_monothread::~grid_monothread() {}
 
 void grid_monothread::monitor(const grid &) {}
 
+void grid_monothread::monitor_profile(const grid_profile &) {}
+
 void grid_monothread::register_optimum(const grid &) {}
 
+void grid_monothread::set_table(size_t bytes) {
+  _table_bytes = bytes;
+}
+
+void grid_monothread::set_counting(bool counting,bool orbits) {
+  _counting = counting;
+  _counts.orbits = orbits;
+}
+
 void grid_monothread::run(dims len,
                           int initial_guess,
+                          grid_engine engine,
+                          int symmetry,
                           bool do_monitor,
                           std::chrono::milliseconds monitor_frequency) {
   query_engine<grid_query> gq;
   query_engine<grid_signal> gs;
+  //The master sleeps on it between events.
+  doorbell bell;
+  gq.set_doorbell(&bell);
+  gs.set_doorbell(&bell);
   auto ps(gs.get_answer_side());
   auto pq(gq.get_query_side());
-  grid_worker wk(gq.get_answer_side(),gs.get_query_side());
+  //Fresh for every run: bounds depend on the problem.
+  std::unique_ptr<transposition_table> table;
+  if(_table_bytes != 0 && !_counting) {
+    table.reset(new transposition_table(_table_bytes));
+  }
+  grid_counts counts;
+  counts.orbits = _counts.orbits;
+  grid_worker wk(gq.get_answer_side(),gs.get_query_side(),nullptr,
+                 table.get(),_counting ? &counts : nullptr);
   std::thread t([&]() { wk.run(); });
   grid_query gqs;
   gqs.query_type = go_to_work_code;
-  grid_job * gj = grid_job::make(len,initial_guess);
+  grid_job * gj = grid_job::make(len,initial_guess,engine,symmetry);
   gqs.start_job = std::unique_ptr<grid_job>(gj);
   pq.query(&gqs);
   pq.wait_answer();
@@ -31,12 +60,13 @@ void grid_monothread::run(dims len,
   std::chrono::high_resolution_clock::time_point last_monitor(time());
   bool monitor_sent(false);
   while(true) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    unsigned seen(bell.seen());
     if(monitor_sent) {
       if(pq.have_answer()) {
         monitor_sent = false;
         last_monitor = time();
         monitor(*(gqs.monitor_grid));
+        monitor_profile(gqs.profile);
         gqs.monitor_grid.reset();
       }
     } else if(do_monitor && time() - last_monitor > monitor_frequency) {
@@ -59,10 +89,22 @@ void grid_monothread::run(dims len,
           pq.query(&gqs);
           pq.wait_answer();
           t.join();
+          _nodes = wk.nodes();
+          _table_probes = wk.table_probes();
+          _table_hits = wk.table_hits();
+          _counts = counts;
           return;
         }
       }
     }
+    std::chrono::milliseconds timeout(1000);
+    if(do_monitor && !monitor_sent) {
+      auto left(std::chrono::duration_cast<std::chrono::milliseconds>(
+        monitor_frequency - (time() - last_monitor)));
+      timeout = left < std::chrono::milliseconds(1) ?
+        std::chrono::milliseconds(1) : left;
+    }
+    bell.wait(seen,timeout);
   }
 }
 
@@ -15,11 +15,33 @@ public:
   virtual ~grid_monothread();
   //What to do with monitored grid. Nothing by default.
   virtual void monitor(const grid &);
+  //What to do with the profile of the monitored worker, which comes
+  //right after its grid. Nothing by default.
+  virtual void monitor_profile(const grid_profile &);
   //What to do with a fresh optimum grid. Nothing by default.
   virtual void register_optimum(const grid &);
-  //Run an instance of the grid problem.
-  void run(dims len,int initial_guess,bool monitor,std::chrono::milliseconds monitor_frequency);
+  //Run an instance of the grid problem (symmetry: grid_symmetry flags).
+  void run(dims len,int initial_guess,grid_engine engine,int symmetry,bool monitor,std::chrono::milliseconds monitor_frequency);
+  //Give next runs a transposition table of the given size (0: none).
+  void set_table(size_t bytes);
+  //Make next runs count the grids with more rooks than initial_guess
+  //(counting mode, see grid_counts) instead of looking for better ones.
+  //No transposition table then.
+  void set_counting(bool counting,bool orbits);
+  //Search nodes explored by the last run.
+  inline uint64_t nodes() const { return _nodes; }
+  //Transposition table probes of the last run, and those that hit.
+  inline uint64_t table_probes() const { return _table_probes; }
+  inline uint64_t table_hits() const { return _table_hits; }
+  //Grids counted by the last run (counting mode).
+  inline const grid_counts & counts() const { return _counts; }
 private:
+  uint64_t _nodes;
+  size_t _table_bytes;
+  uint64_t _table_probes;
+  uint64_t _table_hits;
+  bool _counting;
+  grid_counts _counts;
   query_engine<grid_query> _gqe;
   query_engine<grid_signal> _gse;
 };
@@ -0,0 +1,468 @@
+
+#include "grid_multithread.h"
+#include "checkpoint.h"
+#include "transposition.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <pthread.h>
+
+namespace {
+
+  //A job of the pool, with its bound (grid_job::upper_bound) and when it
+  //came in.
+  struct pooled_job {
+    //Served first: the highest key, then the last one in.
+    int key;
+    int bound;
+    uint64_t rank;
+    std::unique_ptr<grid_job> j;
+  };
+
+  //Pool order (a max-heap).
+  inline bool served_after(const pooled_job & a,const pooled_job & b) {
+    return(a.key < b.key || (a.key == b.key && a.rank < b.rank));
+  }
+
+  //Master-side view of a worker thread.
+  struct worker_slot {
+    inline worker_slot(doorbell * bell,shared_bound * bound,
+                       transposition_table * table,bool counting,
+                       bool orbits) : gq(),gs(),gqs(),counts(),
+      wk(gq.get_answer_side(),gs.get_query_side(),bound,table,
+         counting ? &counts : nullptr),
+      t(),busy(false),query_sent(false) {
+      gq.set_doorbell(bell);
+      gs.set_doorbell(bell);
+      counts.orbits = orbits;
+    }
+    query_engine<grid_query> gq;
+    query_engine<grid_signal> gs;
+    //Query space, reused for every query sent to this worker.
+    grid_query gqs;
+    //Grids counted by the worker (counting mode).
+    grid_counts counts;
+    grid_worker wk;
+    std::thread t;
+    //Is the worker running a job ?
+    bool busy;
+    //Is there a query waiting for an answer ?
+    bool query_sent;
+  };
+
+}
+
+grid_multithread::grid_multithread() : _splits(0),_checkpoints(0),
+  _discarded(0),_nodes(0),
+  _table_bytes(0),_table_probes(0),_table_hits(0),_counting(false),
+  _counts(),_shared_bound(nullptr),_stop(nullptr),_first_cpu(-1),
+  _best_first(true),_stopped(false),_decision(false),_decisions(0),
+  _checkpoint_file(),_checkpoint_period(60),_best_grid() {}
+
+grid_multithread::~grid_multithread() {}
+
+void grid_multithread::monitor(const grid &) {}
+
+void grid_multithread::monitor_profile(const grid_profile &) {}
+
+void grid_multithread::register_optimum(const grid &) {}
+
+void grid_multithread::set_checkpoint(const std::string & file,
+                                      std::chrono::seconds period) {
+  _checkpoint_file = file;
+  _checkpoint_period = period;
+}
+
+void grid_multithread::set_table(size_t bytes) {
+  _table_bytes = bytes;
+}
+
+void grid_multithread::set_counting(bool counting,bool orbits) {
+  _counting = counting;
+  _counts.orbits = orbits;
+}
+
+void grid_multithread::share_bound(shared_bound * b) {
+  _shared_bound = b;
+}
+
+void grid_multithread::set_stop(const std::atomic<bool> * stop) {
+  _stop = stop;
+}
+
+void grid_multithread::set_best_first(bool best_first) {
+  _best_first = best_first;
+}
+
+void grid_multithread::set_cpus(int first_cpu) {
+  _first_cpu = first_cpu;
+}
+
+void grid_multithread::run(dims len,
+                           int initial_guess,
+                           grid_engine engine,
+                           int symmetry,
+                           unsigned threads,
+                           bool do_monitor,
+                           std::chrono::milliseconds monitor_frequency,
+                           const grid * seed) {
+  std::vector< std::unique_ptr<grid_job> > pool;
+  pool.emplace_back(grid_job::make(len,initial_guess,engine,symmetry));
+  _best_grid.reset(seed != nullptr ? grid_job::make_copy(*seed) : nullptr);
+  run_pool(std::move(pool),len,initial_guess,threads,
+           do_monitor,monitor_frequency);
+}
+
+bool grid_multithread::decide(dims len,
+                              int k,
+                              grid_engine engine,
+                              int symmetry,
+                              unsigned threads,
+                              bool do_monitor,
+                              std::chrono::milliseconds monitor_frequency) {
+  _decision = true;
+  run(len,k - 1,engine,symmetry,threads,do_monitor,monitor_frequency);
+  _decision = false;
+  return(_best_grid != nullptr);
+}
+
+int grid_multithread::descend(dims len,
+                              int upper,
+                              int lower,
+                              grid_engine engine,
+                              int symmetry,
+                              unsigned threads,
+                              bool do_monitor,
+                              std::chrono::milliseconds monitor_frequency,
+                              const grid * seed) {
+  uint64_t nodes(0);
+  _decisions = 0;
+  //Was k+1 refuted when k was found ?
+  bool refuted(false);
+  for(int k(upper);k > lower;--k) {
+    bool found(decide(len,k,engine,symmetry,threads,do_monitor,
+                      monitor_frequency));
+    nodes += _nodes;
+    ++_decisions;
+    if(found) { break; }
+    refuted = true;
+  }
+  if(!refuted) {
+    //The upper bound was too low: optimize from the grid found (or from
+    //lower and the seed if none was decided).
+    std::unique_ptr<grid,grid_deleter> found(std::move(_best_grid));
+    run(len,found != nullptr ? grid_job::num_rooks(*found) : lower,engine,
+        symmetry,threads,do_monitor,monitor_frequency,
+        found != nullptr ? found.get() : seed);
+    nodes += _nodes;
+  } else if(_best_grid == nullptr && seed != nullptr) {
+    //Refuted down to lower: the seed is optimal.
+    _best_grid.reset(grid_job::make_copy(*seed));
+  }
+  _nodes = nodes;
+  return(_best_grid != nullptr ? grid_job::num_rooks(*_best_grid) : lower);
+}
+
+bool grid_multithread::resume(const std::string & file,
+                              unsigned threads,
+                              bool do_monitor,
+                              std::chrono::milliseconds monitor_frequency) {
+  grid_checkpoint c;
+  if(!read_checkpoint(file,c)) { return false; }
+  _best_grid = std::move(c.best_grid);
+  if(_best_grid != nullptr) {
+    register_optimum(*_best_grid);
+  }
+  run_pool(std::move(c.jobs),c.size,c.optimum,threads,
+           do_monitor,monitor_frequency);
+  return true;
+}
+
+void grid_multithread::run_pool(std::vector< std::unique_ptr<grid_job> > && jobs,
+                                dims len,
+                                int initial_guess,
+                                unsigned threads,
+                                bool do_monitor,
+                                std::chrono::milliseconds monitor_frequency) {
+  if(threads == 0) { threads = 1; }
+  _splits = 0;
+  _checkpoints = 0;
+  _discarded = 0;
+  _stopped = false;
+  //Rung by every worker query engine: the master sleeps on it.
+  doorbell bell;
+  //Every job prunes with it: no need to broadcast optima.
+  shared_bound own_bound(initial_guess);
+  shared_bound & bound(_shared_bound != nullptr ? *_shared_bound : own_bound);
+  bound.raise(initial_guess);
+  //Fresh for every run as well, and shared the same way.
+  std::unique_ptr<transposition_table> table;
+  if(_table_bytes != 0 && !_counting) {
+    table.reset(new transposition_table(_table_bytes));
+  }
+  std::vector< std::unique_ptr<worker_slot> > slots;
+  for(unsigned i(0);i != threads;++i) {
+    slots.emplace_back(new worker_slot(&bell,&bound,table.get(),_counting,
+                                       _counts.orbits));
+    worker_slot * sl(slots.back().get());
+    sl->t = std::thread([sl]() { sl->wk.run(); });
+    if(_first_cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(_first_cpu + i,&cpus);
+      pthread_setaffinity_np(sl->t.native_handle(),sizeof(cpus),&cpus);
+    }
+  }
+  //Pending jobs, as a heap (a stack when not serving them best first).
+  std::vector<pooled_job> pool;
+  uint64_t rank(0);
+  auto pool_push([&](std::unique_ptr<grid_job> && j) {
+    int b(j->upper_bound());
+    pool.push_back(pooled_job{_best_first ? b : 0,b,rank++,std::move(j)});
+    std::push_heap(pool.begin(),pool.end(),served_after);
+  });
+  for(auto & j : jobs) { pool_push(std::move(j)); }
+  jobs.clear();
+  //Next job worth running, or null.
+  auto pool_pop([&]() {
+    std::unique_ptr<grid_job> j;
+    while(j == nullptr && !pool.empty()) {
+      std::pop_heap(pool.begin(),pool.end(),served_after);
+      if(pool.back().bound <= bound.get()) {
+        ++_discarded;
+      } else {
+        j = std::move(pool.back().j);
+      }
+      pool.pop_back();
+    }
+    return(j);
+  });
+  int best(initial_guess);
+  //Is a split query in flight ? Only one at a time: a whole call stack
+  //usually feeds everyone, and a stack job answers within a few nodes.
+  bool stealing(false);
+  auto send([](worker_slot & sl,grid_query_code c) {
+    sl.gqs.query_type = c;
+    sl.query_sent = true;
+    sl.gq.get_query_side().query(&sl.gqs);
+  });
+  auto time([]() { return std::chrono::high_resolution_clock::now(); });
+  std::chrono::high_resolution_clock::time_point last_monitor(time());
+  size_t next_monitored(0);
+  //Are we gathering every job for a checkpoint ?
+  bool checkpointing(false);
+  std::chrono::high_resolution_clock::time_point last_checkpoint(time());
+  auto checkpoint([&]() {
+    //(Lent by the pool.)
+    for(auto & p : pool) { jobs.push_back(std::move(p.j)); }
+    bool written(write_checkpoint(_checkpoint_file,len,best,_best_grid.get(),
+                                  jobs));
+    for(size_t i(0);i != pool.size();++i) { pool[i].j = std::move(jobs[i]); }
+    jobs.clear();
+    if(written) {
+      ++_checkpoints;
+    } else {
+      std::cerr << "Could not write checkpoint " << _checkpoint_file
+        << std::endl;
+    }
+    last_checkpoint = time();
+  });
+  //How long we may sleep if nothing happens.
+  auto timeout([&]() {
+    typedef std::chrono::milliseconds ms;
+    ms t(1000);
+    if(do_monitor) {
+      auto left(std::chrono::duration_cast<ms>(
+        monitor_frequency - (time() - last_monitor)));
+      if(left < t) { t = left; }
+    }
+    if(!_checkpoint_file.empty()) {
+      auto left(std::chrono::duration_cast<ms>(
+        _checkpoint_period - (time() - last_checkpoint)));
+      if(left < t) { t = left; }
+    }
+    if(_stop != nullptr && t > ms(10)) { t = ms(10); }
+    return(t < ms(1) ? ms(1) : t);
+  });
+  while(true) {
+    unsigned seen(bell.seen());
+    for(auto & psl : slots) {
+      worker_slot & sl(*psl);
+      auto pq(sl.gq.get_query_side());
+      if(sl.query_sent && pq.have_answer()) {
+        sl.query_sent = false;
+        switch(sl.gqs.query_type) {
+        case monitor_code: {
+          //Null if the worker was between two jobs.
+          if(sl.gqs.monitor_grid != nullptr) {
+            monitor(*(sl.gqs.monitor_grid));
+            monitor_profile(sl.gqs.profile);
+            sl.gqs.monitor_grid.reset();
+          }
+          break; }
+        case get_jobs_code:
+        case split_code: {
+          //The worker gave its whole call stack away to answer get_jobs,
+          //and maybe to answer split, so it may now wait for work.
+          stealing = false;
+          if(sl.gqs.query_type == get_jobs_code || !sl.gqs.still_working) {
+            sl.busy = false;
+          }
+          for(auto & j : sl.gqs.jobs) {
+            pool_push(std::move(j));
+          }
+          sl.gqs.jobs.clear();
+          break; }
+        case register_code:
+        case go_to_work_code:
+        case kill_code:
+          break;
+        }
+      }
+      auto ps(sl.gs.get_answer_side());
+      if(ps.have_query()) {
+        auto qr(ps.get_query());
+        switch(qr->signal_type) {
+        case optimum_code: {
+          if(qr->found_optimum > best) {
+            best = qr->found_optimum;
+            _best_grid = std::move(qr->best_grid);
+            register_optimum(*_best_grid);
+          }
+          qr->best_grid.reset();
+          ps.answer();
+          break; }
+        case job_done_code: {
+          sl.busy = false;
+          ps.answer();
+          break; }
+        }
+      }
+    }
+    if(!checkpointing && !_checkpoint_file.empty() &&
+       time() - last_checkpoint > _checkpoint_period) {
+      checkpointing = true;
+    }
+    if(checkpointing) {
+      //Wait until every worker gave its call stack back.
+      bool gathered(true);
+      for(auto & psl : slots) {
+        worker_slot & sl(*psl);
+        if(sl.busy && !sl.query_sent) {
+          send(sl,get_jobs_code);
+        }
+        if(sl.busy || sl.query_sent) { gathered = false; }
+      }
+      if(gathered) {
+        checkpoint();
+        checkpointing = false;
+      }
+    }
+    if(!checkpointing) {
+      //Feed idle workers from the pool.
+      bool have_idle(false);
+      for(auto & psl : slots) {
+        worker_slot & sl(*psl);
+        if(sl.busy || sl.query_sent) { continue; }
+        sl.gqs.start_job = pool_pop();
+        if(sl.gqs.start_job == nullptr) {
+          have_idle = true;
+          continue;
+        }
+        //The bound may come from another search.
+        sl.gqs.start_job->minorate_optimum(bound.get());
+        sl.busy = true;
+        send(sl,go_to_work_code);
+      }
+      //Steal work for idle workers.
+      if(have_idle && !stealing) {
+        for(auto & psl : slots) {
+          worker_slot & sl(*psl);
+          if(sl.busy && !sl.query_sent) {
+            stealing = true;
+            ++_splits;
+            send(sl,split_code);
+            break;
+          }
+        }
+      }
+      //Termination: nothing left to do anywhere.
+      bool finished(pool.empty());
+      for(auto & psl : slots) {
+        if(psl->busy || psl->query_sent) { finished = false; }
+      }
+      if(finished) {
+        //Leave a finished search behind: resuming it does nothing.
+        if(!_checkpoint_file.empty()) { checkpoint(); }
+        break;
+      }
+      if(do_monitor && time() - last_monitor > monitor_frequency) {
+        last_monitor = time();
+        for(size_t i(0);i != slots.size();++i) {
+          worker_slot & sl(*slots[(next_monitored + i) % slots.size()]);
+          if(sl.busy && !sl.query_sent) {
+            next_monitored = (next_monitored + i + 1) % slots.size();
+            send(sl,monitor_code);
+            break;
+          }
+        }
+      }
+    }
+    //Jobs left in the pool are dropped.
+    if(_stop != nullptr && _stop->load(std::memory_order_relaxed)) {
+      _stopped = true;
+      break;
+    }
+    if(_decision && best > initial_guess) {
+      _stopped = true;
+      break;
+    }
+    bell.wait(seen,timeout());
+  }
+  //Once stopped, queries may still be in flight, and workers may be
+  //waiting for a signal to be answered.
+  auto wait_answer([&](worker_slot & sl) {
+    auto pq(sl.gq.get_query_side());
+    auto ps(sl.gs.get_answer_side());
+    while(!pq.have_answer()) {
+      unsigned seen(bell.seen());
+      if(ps.have_query()) {
+        auto qr(ps.get_query());
+        if(qr->signal_type == optimum_code && qr->found_optimum > best) {
+          best = qr->found_optimum;
+          _best_grid = std::move(qr->best_grid);
+          register_optimum(*_best_grid);
+        }
+        qr->best_grid.reset();
+        ps.answer();
+        continue;
+      }
+      bell.wait(seen,std::chrono::milliseconds(10));
+    }
+  });
+  _nodes = 0;
+  _table_probes = 0;
+  _table_hits = 0;
+  bool orbits(_counts.orbits);
+  _counts = grid_counts();
+  _counts.orbits = orbits;
+  for(auto & psl : slots) {
+    worker_slot & sl(*psl);
+    if(sl.query_sent) {
+      wait_answer(sl);
+      sl.gqs.jobs.clear();
+      sl.gqs.monitor_grid.reset();
+    }
+    send(sl,kill_code);
+    wait_answer(sl);
+    sl.t.join();
+    _nodes += sl.wk.nodes();
+    _table_probes += sl.wk.table_probes();
+    _table_hits += sl.wk.table_hits();
+    _counts.merge(sl.counts);
+  }
+}
+
@@ -0,0 +1,155 @@
+#ifndef GRID_MULTITHREAD_H
+#define GRID_MULTITHREAD_H
+
+#include "grid.h"
+#include <chrono>
+#include <string>
+#include <vector>
+#include <memory>
+
+/* Run a grid problem on several grid_worker threads.
+   Jobs are kept in a pool by the master thread, served best bound first
+   (grid_job::upper_bound) or last in first out. Jobs whose bound is no
+   better than the optimum are dropped unrun. When a worker runs
+   out of work while the pool is empty, the master asks a busy worker
+   for part of its call stack (split_code), and the continuations it gets
+   back are spread among the idle workers. A recursive job gives its whole
+   call stack and stops, a stack job gives its shallowest alternatives and
+   keeps on working. Workers share the best optimum
+   through a shared_bound.
+   When checkpointing, every worker is periodically asked for its call
+   stack the same way, which gathers the whole remaining search in the
+   pool; the pool is then written to disk before work resumes.
+   In decision mode (decide), the search stops at the first grid better
+   than its fixed initial guess instead of looking for better ones. */
+class grid_multithread {
+public:
+  grid_multithread();
+  grid_multithread(const grid_multithread &) = delete;
+  grid_multithread(grid_multithread &&) = delete;
+  grid_multithread & operator=(const grid_multithread &) = delete;
+  grid_multithread & operator=(grid_multithread &&) = delete;
+  virtual ~grid_multithread();
+  //What to do with monitored grid. Nothing by default.
+  virtual void monitor(const grid &);
+  //What to do with the profile of the monitored worker, which comes
+  //right after its grid. Nothing by default.
+  virtual void monitor_profile(const grid_profile &);
+  //What to do with a fresh optimum grid. Nothing by default.
+  virtual void register_optimum(const grid &);
+  //Run an instance of the grid problem on the given number of threads
+  //(symmetry: grid_symmetry flags). The seed, if any, is a grid with
+  //initial_guess rooks: it is the best grid (the one checkpoints hold)
+  //until a better one is found. It does not go through register_optimum.
+  void run(dims len,
+           int initial_guess,
+           grid_engine engine,
+           int symmetry,
+           unsigned threads,
+           bool monitor,
+           std::chrono::milliseconds monitor_frequency,
+           const grid * seed = nullptr);
+  //Is there a grid with at least k rooks ? Searches with the optimum fixed
+  //to k-1 and stops at the first such grid (then given to
+  //register_optimum). Prunes much harder than run from a weak guess.
+  bool decide(dims len,
+              int k,
+              grid_engine engine,
+              int symmetry,
+              unsigned threads,
+              bool monitor,
+              std::chrono::milliseconds monitor_frequency);
+  //Optimum found by deciding k = upper, upper-1... down to the first
+  //achievable k, k+1 being refuted, or lower if none is above lower.
+  //If upper itself is achievable (or not above lower), the bound was too
+  //low: the search goes on upward as run does. nodes() covers every
+  //search, decisions() every decision. The seed, if any, has lower rooks
+  //(see run).
+  int descend(dims len,
+              int upper,
+              int lower,
+              grid_engine engine,
+              int symmetry,
+              unsigned threads,
+              bool monitor,
+              std::chrono::milliseconds monitor_frequency,
+              const grid * seed = nullptr);
+  //Restart a search from a checkpoint file. The best grid of the
+  //checkpoint, if any, goes through register_optimum first.
+  //False if the file cannot be read.
+  bool resume(const std::string & file,
+              unsigned threads,
+              bool monitor,
+              std::chrono::milliseconds monitor_frequency);
+  //Checkpoint the search to the given file at the given period
+  //during next runs. An empty file name disables checkpointing.
+  void set_checkpoint(const std::string & file,std::chrono::seconds period);
+  //Give next runs a transposition table of the given size (0: none),
+  //shared by every worker.
+  void set_table(size_t bytes);
+  //Make next runs count the grids with more rooks than initial_guess
+  //(counting mode, see grid_counts) instead of looking for better ones.
+  //Every worker counts on its own, and counts are merged at the end.
+  //No transposition table then, and checkpoints do not hold counts.
+  void set_counting(bool counting,bool orbits);
+  //Make next runs prune with the given bound (not null), raised by other
+  //searches as well, instead of a bound of their own.
+  void share_bound(shared_bound * b);
+  //Make next runs stop, unfinished, as soon as the given flag (not
+  //null) is set. The flag is polled every 10 ms.
+  void set_stop(const std::atomic<bool> * stop);
+  //Serve the jobs of the pool of next runs by decreasing upper bound
+  //(default), or last in first out.
+  void set_best_first(bool best_first);
+  //Pin the worker threads of next runs to CPUs first_cpu, first_cpu+1...
+  //(negative: no pinning).
+  void set_cpus(int first_cpu);
+  //Was the last run stopped (see set_stop and decide) before it was done ?
+  inline bool stopped() const { return _stopped; }
+  //Number of job splits (split_code round-trips) of the last run.
+  inline unsigned long splits() const { return _splits; }
+  //Number of decisions made by the last descend.
+  inline unsigned decisions() const { return _decisions; }
+  //Number of pool jobs the last run dropped by their bound.
+  inline unsigned long discarded() const { return _discarded; }
+  //Number of checkpoints written by the last run.
+  inline unsigned long checkpoints() const { return _checkpoints; }
+  //Search nodes explored by the last run.
+  inline uint64_t nodes() const { return _nodes; }
+  //Transposition table probes of the last run, and those that hit.
+  inline uint64_t table_probes() const { return _table_probes; }
+  inline uint64_t table_hits() const { return _table_hits; }
+  //Grids counted by the last run (counting mode).
+  inline const grid_counts & counts() const { return _counts; }
+private:
+  void run_pool(std::vector< std::unique_ptr<grid_job> > && pool,
+                dims len,
+                int initial_guess,
+                unsigned threads,
+                bool monitor,
+                std::chrono::milliseconds monitor_frequency);
+  unsigned long _splits;
+  unsigned long _checkpoints;
+  unsigned long _discarded;
+  uint64_t _nodes;
+  size_t _table_bytes;
+  uint64_t _table_probes;
+  uint64_t _table_hits;
+  bool _counting;
+  grid_counts _counts;
+  shared_bound * _shared_bound;
+  const std::atomic<bool> * _stop;
+  int _first_cpu;
+  bool _best_first;
+  bool _stopped;
+  //Stop at the first grid better than the initial guess (decide).
+  bool _decision;
+  unsigned _decisions;
+  std::string _checkpoint_file;
+  std::chrono::seconds _checkpoint_period;
+  //Copy of the best grid, needed for checkpoints.
+  std::unique_ptr<grid,grid_deleter> _best_grid;
+};
+
+#endif
+
@@ -0,0 +1,82 @@
+
+#include "grid_portfolio.h"
+#include "grid_multithread.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+namespace {
+
+  //A configuration of the portfolio: its optima go to the portfolio.
+  class portfolio_member : public grid_multithread {
+  public:
+    inline explicit portfolio_member(std::function<void(const grid &)> f) :
+      grid_multithread(),_register(f) {}
+    virtual void register_optimum(const grid & g) { _register(g); }
+  private:
+    std::function<void(const grid &)> _register;
+  };
+
+}
+
+grid_portfolio::grid_portfolio() : _configs(),_winner(0),_optimum_mutex(),
+  _best(0) {}
+
+grid_portfolio::~grid_portfolio() {}
+
+void grid_portfolio::monitor(const grid &) {}
+
+void grid_portfolio::register_optimum(const grid &) {}
+
+void grid_portfolio::add(grid_engine engine,int symmetry,unsigned threads) {
+  _configs.push_back(config{engine,symmetry,threads == 0 ? 1 : threads,
+                            0,0,false});
+}
+
+void grid_portfolio::run(dims len,int initial_guess,bool pin) {
+  //Every configuration prunes with it.
+  shared_bound bound(initial_guess);
+  std::atomic<bool> stop(false);
+  std::atomic<bool> have_winner(false);
+  _best = initial_guess;
+  unsigned needed(0);
+  for(auto & c : _configs) { needed += c.threads; }
+  if(needed > std::thread::hardware_concurrency()) { pin = false; }
+  auto forward([this](const grid & g) {
+    std::lock_guard<std::mutex> lock(_optimum_mutex);
+    if(grid_job::num_rooks(g) > _best) {
+      _best = grid_job::num_rooks(g);
+      register_optimum(g);
+    }
+  });
+  std::vector< std::unique_ptr<portfolio_member> > members;
+  std::vector<std::thread> threads;
+  auto t0(std::chrono::steady_clock::now());
+  int first_cpu(0);
+  for(size_t i(0);i != _configs.size();++i) {
+    config * c(&_configs[i]);
+    members.emplace_back(new portfolio_member(forward));
+    portfolio_member * m(members.back().get());
+    m->share_bound(&bound);
+    m->set_stop(&stop);
+    m->set_cpus(pin ? first_cpu : -1);
+    first_cpu += c->threads;
+    threads.emplace_back([&,c,m,i]() {
+      m->run(len,initial_guess,c->engine,c->symmetry,c->threads,false,
+             std::chrono::milliseconds(0));
+      c->seconds = std::chrono::duration<double>
+        (std::chrono::steady_clock::now() - t0).count();
+      c->nodes = m->nodes();
+      c->done = !m->stopped();
+      //The first one done stops the others.
+      if(c->done && !have_winner.exchange(true)) {
+        _winner = i;
+        stop = true;
+      }
+    });
+  }
+  for(auto & t : threads) { t.join(); }
+}
+
@@ -0,0 +1,61 @@
+#ifndef GRID_PORTFOLIO_H
+#define GRID_PORTFOLIO_H
+
+#include "grid.h"
+#include <vector>
+#include <mutex>
+
+/* Run several engine configurations on the same grid problem at the same
+   time, each one being a grid_multithread search on its own threads
+   (pinned to disjoint CPUs when there are enough of them).
+   Every job of every configuration prunes with one shared_bound, so that
+   an optimum found by any configuration is known by all of them (as
+   register_code would do), and the run ends as soon as one configuration
+   is done: its search proves the optimum. The others are stopped. */
+class grid_portfolio {
+public:
+  //An engine configuration and, once run, how it did.
+  struct config {
+    grid_engine engine;
+    //grid_symmetry flags.
+    int symmetry;
+    unsigned threads;
+    //Search nodes explored, and for how long (until done or stopped).
+    uint64_t nodes;
+    double seconds;
+    //Did the configuration complete its search ?
+    bool done;
+  };
+  grid_portfolio();
+  grid_portfolio(const grid_portfolio &) = delete;
+  grid_portfolio(grid_portfolio &&) = delete;
+  grid_portfolio & operator=(const grid_portfolio &) = delete;
+  grid_portfolio & operator=(grid_portfolio &&) = delete;
+  virtual ~grid_portfolio();
+  //Unused: configurations are not monitored. There for symmetry with
+  //the other drivers.
+  virtual void monitor(const grid &);
+  //What to do with a fresh optimum grid, better than any grid found
+  //before by any configuration. Nothing by default.
+  virtual void register_optimum(const grid &);
+  //Add a configuration, run on the given number of threads.
+  void add(grid_engine engine,int symmetry,unsigned threads);
+  //Run every configuration on an instance of the grid problem until one
+  //of them is done. Threads are pinned if pin is set and the
+  //configurations need no more threads than the hardware has.
+  void run(dims len,int initial_guess,bool pin);
+  //Configurations, and how they did in the last run.
+  inline const std::vector<config> & configs() const { return _configs; }
+  //Index of the configuration that completed its search first in the
+  //last run.
+  inline size_t winner() const { return _winner; }
+private:
+  std::vector<config> _configs;
+  size_t _winner;
+  //Serializes register_optimum calls, from the configurations' threads.
+  std::mutex _optimum_mutex;
+  int _best;
+};
+
+#endif
+
@@ -0,0 +1,183 @@
+
+#include "heuristic.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+  typedef std::tuple<dims,dims,dims> rook;
+
+  //Temperature of the annealing (a move losing k rooks is kept with
+  //probability exp(-k / temperature)).
+  const double anneal_temperature = 0.35;
+  //Moves without improvement after which a thread restarts from its
+  //best placement.
+  const long restart_moves = 200000;
+
+  /* Rooks as the height of each pillar, with the pillar using each line
+     along x and y (-1 if none). A placement is valid when lines hold one
+     rook at most and no empty cell has its three lines used. */
+  class placement {
+  public:
+    explicit placement(int n) : _n(n),_rooks(0),
+      _height(n * n,-1),_xline(n * n,-1),_yline(n * n,-1) {}
+    inline int rooks() const { return _rooks; }
+    inline int height(int x,int y) const { return _height[x * _n + y]; }
+    //Column (row) of the rook on the line along x (y) at y (x), z.
+    inline int xline(int y,int z) const { return _xline[y * _n + z]; }
+    inline int yline(int x,int z) const { return _yline[x * _n + z]; }
+    //Without checks.
+    inline void put(int x,int y,int z) {
+      _height[x * _n + y] = z;
+      _xline[y * _n + z] = x;
+      _yline[x * _n + z] = y;
+      ++_rooks;
+    }
+    inline void remove(int x,int y,std::vector<rook> & removed) {
+      int z(height(x,y));
+      removed.push_back(rook(x,y,z));
+      _height[x * _n + y] = -1;
+      _xline[y * _n + z] = -1;
+      _yline[x * _n + z] = -1;
+      --_rooks;
+    }
+    /* Put a rook at (x,y,z) and remove (to removed) the rooks that make
+       the placement invalid: those on its lines, then one of the rooks
+       behind each cell it makes attacked along the three axes (those
+       cells are on its lines). */
+    void insert(int x,int y,int z,std::mt19937 & rng,
+                std::vector<rook> & removed) {
+      if(height(x,y) >= 0) { remove(x,y,removed); }
+      if(xline(y,z) >= 0) { remove(xline(y,z),y,removed); }
+      if(yline(x,z) >= 0) { remove(x,yline(x,z),removed); }
+      put(x,y,z);
+      for(int k(0);k != _n;++k) {
+        //Cell (x,y,k) of the pillar.
+        if(k != z && xline(y,k) >= 0 && yline(x,k) >= 0) {
+          if(rng() & 1) {
+            remove(xline(y,k),y,removed);
+          } else {
+            remove(x,yline(x,k),removed);
+          }
+        }
+        //Cell (k,y,z) of the line along x, and (x,k,z) along y.
+        if(k != x && height(k,y) >= 0 && yline(k,z) >= 0) {
+          if(rng() & 1) {
+            remove(k,y,removed);
+          } else {
+            remove(k,yline(k,z),removed);
+          }
+        }
+        if(k != y && height(x,k) >= 0 && xline(k,z) >= 0) {
+          if(rng() & 1) {
+            remove(x,k,removed);
+          } else {
+            remove(xline(k,z),k,removed);
+          }
+        }
+      }
+    }
+    //Undo insert(x,y,z,...).
+    void undo(int x,int y,const std::vector<rook> & removed) {
+      std::vector<rook> dummy;
+      remove(x,y,dummy);
+      for(auto & r : removed) {
+        put(std::get<0>(r),std::get<1>(r),std::get<2>(r));
+      }
+    }
+    std::vector<rook> list() const {
+      std::vector<rook> rt;
+      for(int x(0);x != _n;++x) {
+        for(int y(0);y != _n;++y) {
+          if(height(x,y) >= 0) { rt.push_back(rook(x,y,height(x,y))); }
+        }
+      }
+      return(rt);
+    }
+  private:
+    int _n;
+    int _rooks;
+    std::vector<int> _height;
+    std::vector<int> _xline;
+    std::vector<int> _yline;
+  };
+
+  //Best placement over every thread.
+  struct shared_best {
+    shared_best() : rooks(0),list(),mutex() {}
+    std::atomic<int> rooks;
+    std::vector<rook> list;
+    std::mutex mutex;
+  };
+
+  void anneal(int n,
+              std::chrono::steady_clock::time_point deadline,
+              unsigned seed,
+              shared_best & best) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> coin(0,1);
+    placement p(n);
+    placement mine(n);
+    std::vector<rook> removed;
+    long stale(0);
+    for(long moves(0);;++moves) {
+      //The clock is slow next to a move.
+      if((moves & 1023) == 0 && std::chrono::steady_clock::now() > deadline) {
+        return;
+      }
+      int x(rng() % n);
+      int y(rng() % n);
+      int z(rng() % n);
+      if(p.height(x,y) == z) { continue; }
+      int before(p.rooks());
+      removed.clear();
+      p.insert(x,y,z,rng,removed);
+      int lost(before - p.rooks());
+      if(lost > 0 && coin(rng) >= std::exp(-lost / anneal_temperature)) {
+        p.undo(x,y,removed);
+      }
+      if(p.rooks() > mine.rooks()) {
+        mine = p;
+        stale = 0;
+        if(p.rooks() > best.rooks.load(std::memory_order_relaxed)) {
+          std::lock_guard<std::mutex> lock(best.mutex);
+          if(p.rooks() > best.rooks.load(std::memory_order_relaxed)) {
+            best.rooks = p.rooks();
+            best.list = p.list();
+          }
+        }
+      } else if(++stale == restart_moves) {
+        p = mine;
+        stale = 0;
+      }
+    }
+  }
+
+}
+
+std::unique_ptr<grid,grid_deleter> heuristic_grid(dims len,
+                                                  double seconds,
+                                                  unsigned threads) {
+  if(seconds <= 0 || len < 1) { return(nullptr); }
+  if(threads == 0) { threads = 1; }
+  auto deadline(std::chrono::steady_clock::now() +
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>
+      (std::chrono::duration<double>(seconds)));
+  shared_best best;
+  std::random_device rd;
+  std::vector<std::thread> ts;
+  for(unsigned i(0);i != threads;++i) {
+    unsigned seed(rd() + i);
+    ts.emplace_back([&,seed]() { anneal(len,deadline,seed,best); });
+  }
+  for(auto & t : ts) { t.join(); }
+  return(std::unique_ptr<grid,grid_deleter>
+    (grid_job::make_grid(len,best.list)));
+}
+
@@ -0,0 +1,22 @@
+#ifndef HEURISTIC_H
+#define HEURISTIC_H
+
+#include "grid.h"
+#include <memory>
+
+/* Heuristic lower bound for the grid problem, to seed the exact search
+   with (as its initial guess) instead of 0.
+   Simulated annealing over rook placements: a move puts a rook on a
+   random cell and removes the rooks it conflicts with, and is kept if
+   it loses no rook, or with a probability falling exponentially with the
+   rooks it loses. Every thread anneals on its own, restarting from the
+   best placement it knows whenever it has not improved for a while. */
+
+//Best grid found on the given number of threads within the given time.
+//Null if none (no time).
+std::unique_ptr<grid,grid_deleter> heuristic_grid(dims len,
+                                                  double seconds,
+                                                  unsigned threads);
+
+#endif
+
@@ -1,5 +1,6 @@
 
 #include "job.h"
+#include "serial.h"
 
 /* Looks ridiculous,
    but I do not want
@@ -9,3 +10,23 @@ job::~job() {}
 
 job_id::~job_id() {}
 
+
+/* Full format: id length (one byte), id, then the job payload
+   up to the end of the window. */
+void job_id_manager::serialize(job & j,std::string & buf) {
+  const std::string & id(j.get_job_id());
+  put_u8(buf,static_cast<uint8_t>(id.size()));
+  buf.append(id);
+  j.serialize(buf);
+}
+
+job * job_id_manager::deserialize(const std::string & buf,size_t l,size_t u) {
+  serial_reader r(buf,l,u);
+  uint8_t len;
+  if(!r.get_u8(len)) { return(NULL); }
+  size_t start(r.pos());
+  if(!r.skip(len)) { return(NULL); }
+  std::string id(buf,start,len);
+  if(!have_id(id)) { return(NULL); }
+  return(from_id(id).deserialize(buf,r.pos(),r.end()));
+}
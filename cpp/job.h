@@ -62,11 +62,20 @@ public:
   job_id_manager(const job_id_manager &) = delete;
   job_id_manager & operator=(const job_id_manager &) = delete;
   inline job_id & from_id(std::string & s) { return *(_table[s]); }
+  inline bool have_id(const std::string & s) const {
+    return(_table.find(s) != _table.end());
+  }
   inline void register_id(std::string && s,std::unique_ptr<job_id> && j) {
     std::pair<std::string,std::unique_ptr<job_id> >
       pr(std::move(s),std::move(j));
     _table.insert(std::move(pr));
   }
+  /* Full serialization of a job (appended to given string buffer):
+     the job id followed by the job own serialization. */
+  static void serialize(job &,std::string &);
+  /* re-construct a job from its full serialization (between bounds
+     in the string). NULL if the id is unknown or the data malformed. */
+  job * deserialize(const std::string &,size_t l,size_t u);
 private:
   std::unordered_map<std::string,std::unique_ptr<job_id> > _table;
 };
@@ -1,65 +1,598 @@
 
 #include <iostream>
+#include <iomanip>
 #include <thread>
 #include <chrono>
 #include <memory>
-#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include "grid_monothread.h"
+#include "grid_multithread.h"
+#include "farm.h"
+#include "grid_portfolio.h"
+#include "heuristic.h"
+#include "shard.h"
 
-class main_grid_monothread : public grid_monothread {
+/* Printing layer, shared by the single and multi-threaded drivers. */
+template < typename D > class main_grid : public D {
 public:
-  main_grid_monothread(int reminder_rate);
+  main_grid(int reminder_rate);
   virtual void monitor(const grid &);
+  virtual void monitor_profile(const grid_profile &);
   virtual void register_optimum(const grid &);
   void after_run();
+  //Rooks of the best grid found, or -1.
+  inline int best_rooks() const {
+    return(_shown_grid == nullptr ? -1 : grid_job::num_rooks(*_shown_grid));
+  }
 private:
-  std::unique_ptr<grid,grid_deleter> _best_grid;
+  //Last grid given to register_optimum. The drivers keep their own.
+  std::unique_ptr<grid,grid_deleter> _shown_grid;
   int _reminder_rate;
   int _reminder;
 };
 
-main_grid_monothread::main_grid_monothread(int reminder_rate) :
-  grid_monothread(),_best_grid(),
+template < typename D >
+main_grid<D>::main_grid(int reminder_rate) :
+  D(),_shown_grid(),
   _reminder_rate(reminder_rate),_reminder(reminder_rate) {}
 
-void main_grid_monothread::monitor(const grid & g) {
+template < typename D >
+void main_grid<D>::monitor(const grid & g) {
   std::cout << "Current state:" << std::endl;
   grid_job::print(g,std::cout);
   if(--_reminder == 0) {
     _reminder = _reminder_rate;
-    if(_best_grid.get() != nullptr) {
+    if(_shown_grid.get() != nullptr) {
       std::cout << "Reminder (best state):" << std::endl;
-      grid_job::print(*_best_grid,std::cout);
+      grid_job::print(*_shown_grid,std::cout);
     }
   }
 }
 
-void main_grid_monothread::register_optimum(const grid & g) {
-  _best_grid = std::unique_ptr<grid,grid_deleter>(grid_job::make_copy(g));
+template < typename D >
+void main_grid<D>::monitor_profile(const grid_profile & p) {
+  if(!p.enabled) { return; }
+  std::cout << "Profile: " << static_cast<uint64_t>(p.rate) << " nodes/s, "
+    << p.leaves << " leaves, " << p.optima << " optima" << std::endl;
+  std::cout << "  row        nodes    bound cuts    order cuts   attack cuts"
+    << std::endl;
+  for(int y(max_grid_size - 1);y >= 0;--y) {
+    if(p.nodes[y] == 0) { continue; }
+    std::cout << std::setw(5) << y << std::setw(13) << p.nodes[y]
+      << std::setw(14) << p.bound_cuts[y] << std::setw(14) << p.order_cuts[y]
+      << std::setw(14) << p.attack_cuts[y] << std::endl;
+  }
+}
+
+template < typename D >
+void main_grid<D>::register_optimum(const grid & g) {
+  _shown_grid = std::unique_ptr<grid,grid_deleter>(grid_job::make_copy(g));
   std::cout << "New optimum found!" << std::endl;
-  grid_job::print(*_best_grid,std::cout);
+  grid_job::print(*_shown_grid,std::cout);
 }
 
-void main_grid_monothread::after_run() {
-  if(_best_grid == nullptr) {
+template < typename D >
+void main_grid<D>::after_run() {
+  if(_shown_grid == nullptr) {
     std::cout << "No optimum found. Initial guess was too high." << std::endl;
   } else {
     std::cout << "Best grid found:" << std::endl;
-    grid_job::print(*_best_grid,std::cout);
+    grid_job::print(*_shown_grid,std::cout);
+  }
+}
+
+//Transposition table statistics of a run, if it had a table.
+template<typename D>
+static void print_table(const D & gm,size_t table_bytes) {
+  if(table_bytes == 0) { return; }
+  std::cout << "Table hits: " << gm.table_hits() << " / "
+    << gm.table_probes() << " probes";
+  if(gm.table_probes() != 0) {
+    std::cout << " (" << 100.0 * gm.table_hits() / gm.table_probes() << "%)";
+  }
+  std::cout << std::endl;
+}
+
+/* Heuristic grid found within the given time, if it has more rooks than
+   the guess, which it then becomes. */
+static std::unique_ptr<grid,grid_deleter> seed_grid(dims len,
+                                                    int seconds,
+                                                    unsigned threads,
+                                                    int & guess) {
+  std::unique_ptr<grid,grid_deleter> g(heuristic_grid(len,seconds,threads));
+  if(g == nullptr || grid_job::num_rooks(*g) <= guess) { return(nullptr); }
+  guess = grid_job::num_rooks(*g);
+  std::cout << "Heuristic grid: " << guess << " rooks" << std::endl;
+  return(g);
+}
+
+/* Count the optimal grids on the given number of threads, solving the
+   problem first if the optimum is not given (non positive), from the seed
+   grid if any. */
+static int count_optimal(dims len,
+                         int guess,
+                         const grid * seed,
+                         int optimum,
+                         grid_engine engine,
+                         int symmetry,
+                         unsigned threads,
+                         bool orbits,
+                         size_t table_bytes) {
+  if(optimum <= 0) {
+    main_grid<grid_multithread> gm(10);
+    gm.set_table(table_bytes);
+    if(seed != nullptr) { gm.register_optimum(*seed); }
+    gm.run(len,guess,engine,symmetry,threads,false,
+           std::chrono::milliseconds(0),seed);
+    gm.after_run();
+    std::cout << "Nodes: " << gm.nodes() << std::endl;
+    optimum = gm.best_rooks();
+    if(optimum < 0) { return(-1); }
+  }
+  grid_multithread gc;
+  gc.set_counting(true,orbits);
+  gc.run(len,optimum - 1,engine,symmetry,threads,false,
+         std::chrono::milliseconds(0));
+  const grid_counts & c(gc.counts());
+  std::cout << "Counting nodes: " << gc.nodes() << std::endl;
+  std::cout << "Grids with " << optimum << " rooks (kept): " << c.kept
+    << std::endl;
+  if(orbits) {
+    std::cout << "Grids with " << optimum << " rooks (all): " << c.all(len)
+      << std::endl;
+  }
+  return(0);
+}
+
+//Engine of an --engine name. False if unknown.
+static bool parse_engine(const std::string & name,grid_engine & engine) {
+  if(name == "recursive") {
+    engine = grid_engine_recursive;
+  } else if(name == "stack") {
+    engine = grid_engine_stack;
+  } else if(name == "floor") {
+    engine = grid_engine_floor;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//grid_symmetry flags of a --symmetry name. False if unknown.
+static bool parse_symmetry(const std::string & name,int & symmetry) {
+  if(name == "none") {
+    symmetry = 0;
+  } else if(name == "cards") {
+    symmetry = grid_symmetry_cards;
+  } else if(name == "all") {
+    symmetry = grid_symmetry_cards | grid_symmetry_equilibrium;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/* Run the engine configurations of a portfolio (engine[:symmetry],
+   comma separated) until one of them is done, sharing the threads
+   among them. */
+static int run_portfolio(const std::string & spec,
+                         dims len,
+                         int guess,
+                         const grid * seed,
+                         unsigned threads) {
+  std::vector<std::string> names;
+  for(size_t b(0);b <= spec.size();) {
+    size_t e(spec.find(',',b));
+    if(e == std::string::npos) { e = spec.size(); }
+    names.push_back(spec.substr(b,e - b));
+    b = e + 1;
+  }
+  main_grid<grid_portfolio> gm(10);
+  for(size_t i(0);i != names.size();++i) {
+    size_t colon(names[i].find(':'));
+    grid_engine engine;
+    int symmetry(0);
+    if(!parse_engine(names[i].substr(0,colon),engine) ||
+       (colon != std::string::npos &&
+        !parse_symmetry(names[i].substr(colon + 1),symmetry)) ||
+       (engine == grid_engine_floor && symmetry != 0)) {
+      std::cout << "Bad portfolio configuration " << names[i] << std::endl;
+      return(-1);
+    }
+    unsigned share(threads / names.size() +
+                   (i < threads % names.size() ? 1 : 0));
+    gm.add(engine,symmetry,share);
+  }
+  if(seed != nullptr) { gm.register_optimum(*seed); }
+  gm.run(len,guess,true);
+  gm.after_run();
+  const std::vector<grid_portfolio::config> & cs(gm.configs());
+  std::cout << "Winner: " << names[gm.winner()] << " in "
+    << cs[gm.winner()].seconds << " s" << std::endl;
+  for(size_t i(0);i != cs.size();++i) {
+    std::cout << "  " << names[i] << " (" << cs[i].threads << " threads): "
+      << cs[i].nodes << " nodes, "
+      << static_cast<uint64_t>(cs[i].seconds > 0 ?
+                               cs[i].nodes / cs[i].seconds : 0)
+      << " nodes/s, " << (cs[i].done ? "done" : "stopped") << std::endl;
+  }
+  return(0);
+}
+
+/* Split the problem into shard files, as grid_job_pillar jobs starting
+   from the grids whose first rows are complete. */
+static int write_shard_files(const std::string & prefix,
+                             unsigned count,
+                             dims len,
+                             int guess,
+                             const grid * seed,
+                             int symmetry,
+                             dims rows) {
+  std::vector<uint64_t> loads;
+  size_t jobs;
+  if(!write_shards(prefix,count,len,guess,seed,symmetry,rows,loads,jobs)) {
+    std::cout << "Cannot write shards " << prefix << std::endl;
+    return(-1);
+  }
+  std::cout << "Jobs: " << jobs << std::endl;
+  for(unsigned i(0);i != count;++i) {
+    std::cout << "  " << shard_file(prefix,i) << ": estimated load "
+      << loads[i] << std::endl;
+  }
+  return(0);
+}
+
+//Best grid over shard files.
+static int merge_shard_files(const std::string & prefix,unsigned count) {
+  grid_checkpoint c;
+  unsigned unfinished;
+  if(!merge_shards(prefix,count,c,unfinished)) {
+    std::cout << "Cannot read shards " << prefix << std::endl;
+    return(-1);
+  }
+  if(c.best_grid == nullptr) {
+    std::cout << "No grid with more than " << c.optimum << " rooks"
+      << std::endl;
+  } else {
+    std::cout << "Best grid found:" << std::endl;
+    grid_job::print(*c.best_grid,std::cout);
+  }
+  if(unfinished != 0) {
+    std::cout << "Unfinished shards: " << unfinished << std::endl;
   }
+  return(0);
+}
+
+static void usage(const char * name) {
+  std::cout << "usage: " << name
+    << " [-n size] [-g initial_guess] [-t threads] [-m monitor_ms]"
+    << std::endl
+    << "    [--engine recursive|stack|floor] [--symmetry none|cards|all]"
+    << std::endl
+    << "    [--checkpoint file] [--checkpoint-every seconds] [--resume file]"
+    << std::endl
+    << "    [--table-mb megabytes] [--count kept|all [--optimum rooks]]"
+    << std::endl
+    << "    [--portfolio engine[:symmetry],...] [--heuristic seconds]"
+    << std::endl
+    << "    [--decide upper_bound]"
+    << std::endl
+    << "  -t 0 uses every hardware thread, -m 0 disables monitoring."
+    << std::endl
+    << "  --engine chooses the backtracking engine (recursive by default):"
+    << std::endl
+    << "  floor is the floor by floor search of rooks.c, without --symmetry."
+    << std::endl
+    << "  --symmetry adds symmetry breaking rules between the axis (none by"
+    << std::endl
+    << "  default): cards caps the rooks of columns and floors by those of"
+    << std::endl
+    << "  the first row, all also caps how many of them reach it. all prunes"
+    << std::endl
+    << "  more for a fixed bound (--decide, --count), but from a low guess"
+    << std::endl
+    << "  it may find the optimum later."
+    << std::endl
+    << "  --checkpoint saves the search every 60 seconds by default,"
+    << std::endl
+    << "  --resume restarts from such a file (-n and -g are then ignored)."
+    << std::endl
+    << "  --table-mb skips the rows already searched from an identical state"
+    << std::endl
+    << "  (recursive engine), through a table of that size (none by default)."
+    << std::endl
+    << "  --count counts the optimal grids once the optimum is found (or given),"
+    << std::endl
+    << "  those the engine keeps up to permutations of the axis (kept) or"
+    << std::endl
+    << "  every one of them (all, without --symmetry and for size 9 at most)."
+    << std::endl
+    << "  --portfolio runs several configurations at once, sharing the -t threads"
+    << std::endl
+    << "  and the best optimum, until the first one is done."
+    << std::endl
+    << "  --heuristic first looks for a grid by annealing on the -t threads for"
+    << std::endl
+    << "  that long, and searches from its rooks if better than -g (not on"
+    << std::endl
+    << "  --resume)."
+    << std::endl
+    << "  --decide asks whether upper_bound rooks, then one less... fit, each"
+    << std::endl
+    << "  search stopping at its first grid, down to the guess (-g or"
+    << std::endl
+    << "  --heuristic). If upper_bound fits, the search goes on upward."
+    << std::endl
+    << "   or: " << name << " --coordinator address [-n size] [-g initial_guess]"
+    << std::endl
+    << "    [--heuristic seconds]"
+    << std::endl
+    << "    [--engine recursive|stack|floor] [--symmetry none|cards|all]"
+    << std::endl
+    << "   or: " << name << " --worker address [--table-mb megabytes]"
+    << std::endl
+    << "  to spread a search over processes, address being unix:<path>"
+    << std::endl
+    << "  or tcp:[<ipv4>:]<port> (loopback by default)."
+    << std::endl
+    << "   or: " << name << " --shard prefix [--shards count] [--shard-rows rows]"
+    << std::endl
+    << "    [-n size] [-g initial_guess] [--heuristic seconds] [--symmetry ...]"
+    << std::endl
+    << "   or: " << name << " --solve-shard file [-t threads] [-m monitor_ms]"
+    << std::endl
+    << "   or: " << name << " --merge prefix [--shards count]"
+    << std::endl
+    << "  to split a search into prefix.0 ... files (16 by default), starting"
+    << std::endl
+    << "  once the first rows (1 by default) are filled, solve each one on its"
+    << std::endl
+    << "  own (the file then holds its result, and the search can be restarted"
+    << std::endl
+    << "  from it), and merge their results."
+    << std::endl;
 }
 
 int main(int argc,const char * argv[]) {
-  main_grid_monothread gm(10);
-  dims len(9);
+  int len(9);
   int guess(0);
-  if(sizeof(bitset) * std::numeric_limits<unsigned char>::digits
-    < static_cast<unsigned int>(len)) {
-    std::cout << "Recompile with larger bitset" << std::endl;
+  int threads(1);
+  int monitor_ms(1000);
+  int checkpoint_every(60);
+  int table_mb(0);
+  int optimum(0);
+  int heuristic_seconds(0);
+  int upper(0);
+  int shards(16);
+  int shard_rows(1);
+  std::string count_name("none");
+  std::string checkpoint_file;
+  std::string resume_file;
+  std::string coordinator_address;
+  std::string worker_address;
+  std::string engine_name("recursive");
+  std::string symmetry_name("none");
+  std::string portfolio_spec;
+  std::string shard_prefix;
+  std::string solve_shard;
+  std::string merge_prefix;
+  for(int i(1);i != argc;++i) {
+    int * target(nullptr);
+    std::string * starget(nullptr);
+    if(!std::strcmp(argv[i],"-n")) { target = &len; }
+    else if(!std::strcmp(argv[i],"-g")) { target = &guess; }
+    else if(!std::strcmp(argv[i],"-t")) { target = &threads; }
+    else if(!std::strcmp(argv[i],"-m")) { target = &monitor_ms; }
+    else if(!std::strcmp(argv[i],"--checkpoint-every")) {
+      target = &checkpoint_every;
+    }
+    else if(!std::strcmp(argv[i],"--checkpoint")) {
+      starget = &checkpoint_file;
+    }
+    else if(!std::strcmp(argv[i],"--resume")) { starget = &resume_file; }
+    else if(!std::strcmp(argv[i],"--table-mb")) { target = &table_mb; }
+    else if(!std::strcmp(argv[i],"--count")) { starget = &count_name; }
+    else if(!std::strcmp(argv[i],"--optimum")) { target = &optimum; }
+    else if(!std::strcmp(argv[i],"--decide")) { target = &upper; }
+    else if(!std::strcmp(argv[i],"--shard")) { starget = &shard_prefix; }
+    else if(!std::strcmp(argv[i],"--shards")) { target = &shards; }
+    else if(!std::strcmp(argv[i],"--shard-rows")) { target = &shard_rows; }
+    else if(!std::strcmp(argv[i],"--solve-shard")) { starget = &solve_shard; }
+    else if(!std::strcmp(argv[i],"--merge")) { starget = &merge_prefix; }
+    else if(!std::strcmp(argv[i],"--heuristic")) {
+      target = &heuristic_seconds;
+    }
+    else if(!std::strcmp(argv[i],"--coordinator")) {
+      starget = &coordinator_address;
+    }
+    else if(!std::strcmp(argv[i],"--worker")) { starget = &worker_address; }
+    else if(!std::strcmp(argv[i],"--engine")) { starget = &engine_name; }
+    else if(!std::strcmp(argv[i],"--symmetry")) { starget = &symmetry_name; }
+    else if(!std::strcmp(argv[i],"--portfolio")) { starget = &portfolio_spec; }
+    if((target == nullptr && starget == nullptr) || i+1 == argc) {
+      usage(argv[0]);
+      return(-1);
+    }
+    ++i;
+    if(target != nullptr) {
+      *target = std::atoi(argv[i]);
+    } else {
+      *starget = argv[i];
+    }
+  }
+  if(table_mb < 0) {
+    usage(argv[0]);
     return(-1);
   }
-  gm.run(len,guess,true,std::chrono::milliseconds(1000));
-  gm.after_run();
+  size_t table_bytes(static_cast<size_t>(table_mb) << 20);
+  if(!worker_address.empty()) {
+    if(!farm_worker_run(worker_address,table_bytes)) {
+      std::cout << "Cannot reach coordinator " << worker_address << std::endl;
+      return(-1);
+    }
+    return(0);
+  }
+  if(shards < 1) {
+    usage(argv[0]);
+    return(-1);
+  }
+  if(!merge_prefix.empty()) {
+    return(merge_shard_files(merge_prefix,shards));
+  }
+  if(!solve_shard.empty()) {
+    if(!resume_file.empty() || !checkpoint_file.empty()) {
+      std::cout << "A shard is its own checkpoint" << std::endl;
+      return(-1);
+    }
+    resume_file = solve_shard;
+    checkpoint_file = solve_shard;
+  }
+  grid_engine engine;
+  int symmetry;
+  if(!parse_engine(engine_name,engine) ||
+     !parse_symmetry(symmetry_name,symmetry)) {
+    usage(argv[0]);
+    return(-1);
+  }
+  if(len < 1) {
+    usage(argv[0]);
+    return(-1);
+  }
+  if(len > max_grid_size) {
+    std::cout << "Size is at most " << static_cast<int>(max_grid_size)
+      << std::endl;
+    return(-1);
+  }
+  if(count_name != "none" && count_name != "kept" && count_name != "all") {
+    usage(argv[0]);
+    return(-1);
+  }
+  bool orbits(count_name == "all");
+  if(count_name != "none" && (!coordinator_address.empty() ||
+                              !checkpoint_file.empty() ||
+                              !resume_file.empty())) {
+    std::cout << "Counting runs in a single process, without checkpoints"
+      << std::endl;
+    return(-1);
+  }
+  if(engine == grid_engine_floor && (symmetry != 0 || count_name != "none")) {
+    std::cout << "The floor engine has its own symmetry breaking: no --symmetry"
+      << " nor --count" << std::endl;
+    return(-1);
+  }
+  if(!portfolio_spec.empty() && (count_name != "none" ||
+                                 !coordinator_address.empty() ||
+                                 !checkpoint_file.empty() ||
+                                 !resume_file.empty())) {
+    std::cout << "A portfolio runs in a single process, without checkpoints"
+      << " nor counting" << std::endl;
+    return(-1);
+  }
+  if(upper > 0 && (count_name != "none" || !portfolio_spec.empty() ||
+                   !coordinator_address.empty() ||
+                   !checkpoint_file.empty() || !resume_file.empty())) {
+    std::cout << "Decisions run in a single process, without checkpoints,"
+      << " counting nor portfolio" << std::endl;
+    return(-1);
+  }
+  if(!shard_prefix.empty() && (count_name != "none" || upper > 0 ||
+                                !portfolio_spec.empty() ||
+                                !coordinator_address.empty() ||
+                                !checkpoint_file.empty() ||
+                                !resume_file.empty() ||
+                                engine != grid_engine_recursive)) {
+    std::cout << "Shards hold recursive engine jobs, without counting"
+      << std::endl;
+    return(-1);
+  }
+  if(!shard_prefix.empty() && (shard_rows < 1 || shard_rows >= len)) {
+    std::cout << "Shards start from 1 to " << len - 1 << " rows"
+      << std::endl;
+    return(-1);
+  }
+  if(orbits && (symmetry != 0 || len > 9)) {
+    std::cout << "Counting every grid needs no --symmetry and size 9 at most"
+      << std::endl;
+    return(-1);
+  }
+  if(threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  bool do_monitor(monitor_ms > 0);
+  std::chrono::milliseconds monitor_frequency(monitor_ms);
+  //Useless when counting from a given optimum.
+  std::unique_ptr<grid,grid_deleter> seed;
+  if(heuristic_seconds > 0 && resume_file.empty() &&
+     (count_name == "none" || optimum <= 0)) {
+    seed = seed_grid(len,heuristic_seconds,threads,guess);
+  }
+  if(!shard_prefix.empty()) {
+    return(write_shard_files(shard_prefix,shards,len,guess,seed.get(),
+                             symmetry,shard_rows));
+  } else if(upper > 0) {
+    main_grid<grid_multithread> gm(10);
+    gm.set_table(table_bytes);
+    if(seed != nullptr) { gm.register_optimum(*seed); }
+    int rooks(gm.descend(len,upper,guess,engine,symmetry,threads,do_monitor,
+                         monitor_frequency,seed.get()));
+    gm.after_run();
+    //Every grid above the guess was ruled out: the seed, if any, is
+    //optimal.
+    if(rooks > guess || seed != nullptr) {
+      std::cout << "Optimum: " << rooks << std::endl;
+    } else {
+      std::cout << "No grid with more than " << guess << " rooks"
+        << std::endl;
+    }
+    std::cout << "Decisions: " << gm.decisions() << std::endl;
+    std::cout << "Nodes: " << gm.nodes() << std::endl;
+  } else if(!portfolio_spec.empty()) {
+    return(run_portfolio(portfolio_spec,len,guess,seed.get(),threads));
+  } else if(count_name != "none") {
+    return(count_optimal(len,guess,seed.get(),optimum,engine,symmetry,
+                         threads,orbits,table_bytes));
+  } else if(!coordinator_address.empty()) {
+    main_grid<farm_coordinator> gm(10);
+    if(seed != nullptr) { gm.register_optimum(*seed); }
+    if(!gm.run(coordinator_address,len,guess,engine,symmetry)) {
+      std::cout << "Cannot listen on " << coordinator_address << std::endl;
+      return(-1);
+    }
+    gm.after_run();
+    std::cout << "Job splits: " << gm.splits() << std::endl;
+    std::cout << "Jobs re-issued: " << gm.reissued() << std::endl;
+  } else if(threads <= 1 && checkpoint_file.empty() && resume_file.empty()) {
+    main_grid<grid_monothread> gm(10);
+    gm.set_table(table_bytes);
+    if(seed != nullptr) { gm.register_optimum(*seed); }
+    gm.run(len,guess,engine,symmetry,do_monitor,monitor_frequency);
+    gm.after_run();
+    std::cout << "Nodes: " << gm.nodes() << std::endl;
+    print_table(gm,table_bytes);
+  } else {
+    main_grid<grid_multithread> gm(10);
+    gm.set_checkpoint(checkpoint_file,
+                      std::chrono::seconds(checkpoint_every));
+    gm.set_table(table_bytes);
+    if(seed != nullptr) { gm.register_optimum(*seed); }
+    if(resume_file.empty()) {
+      gm.run(len,guess,engine,symmetry,threads,do_monitor,
+             monitor_frequency,seed.get());
+    } else if(!gm.resume(resume_file,threads,do_monitor,monitor_frequency)) {
+      std::cout << "Cannot read checkpoint " << resume_file << std::endl;
+      return(-1);
+    }
+    gm.after_run();
+    std::cout << "Nodes: " << gm.nodes() << std::endl;
+    print_table(gm,table_bytes);
+    std::cout << "Job splits: " << gm.splits() << std::endl;
+    if(!checkpoint_file.empty()) {
+      std::cout << "Checkpoints written: " << gm.checkpoints() << std::endl;
+    }
+  }
   return(0);
 }
 
@@ -4,6 +4,14 @@
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <cinttypes>
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+#endif
 
 /* template for inter-thread communication.
  * It is asymetric: the master thread query and the slave thread answer.
@@ -12,6 +20,52 @@
 template < typename Q > class query_side;
 template < typename Q > class answer_side;
 template < typename Q > class query_engine;
+class doorbell;
+
+//How waits are performed.
+enum query_wait_mode {
+  //Sleep by 1ms steps until the state changes.
+  query_wait_poll,
+  //Block in the kernel (futex) until the other side wakes us up.
+  //Falls back to polling where futexes are not available.
+  query_wait_block
+};
+
+#ifdef __linux__
+inline void futex_wait(std::atomic<int> * addr,int v) {
+  syscall(SYS_futex,reinterpret_cast<int *>(addr),FUTEX_WAIT_PRIVATE,
+          v,nullptr,nullptr,0);
+}
+
+inline void futex_wake(std::atomic<int> * addr) {
+  syscall(SYS_futex,reinterpret_cast<int *>(addr),FUTEX_WAKE_PRIVATE,
+          1,nullptr,nullptr,0);
+}
+#endif
+
+/* Lets a master thread sleep until something happens on any of the
+   engines it watches (see query_engine::set_doorbell), a timeout
+   expires, or optionally a file descriptor becomes readable.
+   Usage: take seen(), check every engine, then wait(seen,...):
+   a ring in-between makes the wait return immediately. */
+class doorbell {
+public:
+  inline doorbell();
+  inline ~doorbell();
+  doorbell(const doorbell &) = delete;
+  doorbell & operator=(const doorbell &) = delete;
+  inline unsigned seen() const { return _seq.load(std::memory_order_seq_cst); }
+  inline void ring();
+  //Wait until a ring happened after seen() returned s, for at most
+  //the timeout. fd, if non-negative, also ends the wait when readable.
+  inline void wait(unsigned s,std::chrono::milliseconds timeout,int fd = -1);
+private:
+  std::atomic<unsigned> _seq;
+  std::atomic<int> _sleepers;
+#ifdef __linux__
+  int _fd;
+#endif
+};
 
 /* note: query and answer sides are "raw" references
    on the engine, and as such should be used only
@@ -61,19 +115,119 @@ private:
 /* Engine from which query/answer sides are derived. */
 template < typename Q > class query_engine {
 public:
-  inline query_engine();
+  inline explicit query_engine(query_wait_mode m = query_wait_block);
   inline ~query_engine() = default;
   query_engine(const query_engine<Q> &) = delete;
   query_engine<Q> & operator=(const query_engine<Q> &) = delete;
   inline query_side<Q> get_query_side();
   inline answer_side<Q> get_answer_side();
+  //Ring the given doorbell on every query and answer (nullptr: none).
+  //To be set before any query is sent.
+  inline void set_doorbell(doorbell * b) { _bell = b; }
 private:
   friend class query_side<Q>;
   friend class answer_side<Q>;
+  //Publish a new _ms value and wake up whoever waits for it.
+  inline void set_state(int v);
+  //Return once _ms is no longer v.
+  inline void wait_change(int v);
   Q * _query;
-  std::atomic<bool> _ms;
+  //1 while a query is pending. An int, so that futexes can wait on it.
+  std::atomic<int> _ms;
+  //Threads blocked on _ms. Lets set_state skip the wake-up syscall
+  //in the common case.
+  std::atomic<int> _sleepers;
+  query_wait_mode _mode;
+  doorbell * _bell;
 };
 
+inline doorbell::doorbell() : _seq(0),_sleepers(0)
+#ifdef __linux__
+  ,_fd(eventfd(0,EFD_NONBLOCK | EFD_CLOEXEC))
+#endif
+  {}
+
+inline doorbell::~doorbell() {
+#ifdef __linux__
+  if(_fd >= 0) { close(_fd); }
+#endif
+}
+
+inline void doorbell::ring() {
+  _seq.fetch_add(1,std::memory_order_seq_cst);
+#ifdef __linux__
+  if(_sleepers.load(std::memory_order_seq_cst) != 0) {
+    uint64_t one(1);
+    ssize_t r(write(_fd,&one,sizeof(one)));
+    (void)r;
+  }
+#endif
+}
+
+inline void doorbell::wait(unsigned s,
+                           std::chrono::milliseconds timeout,
+                           int fd) {
+#ifdef __linux__
+  if(_fd >= 0) {
+    _sleepers.fetch_add(1,std::memory_order_seq_cst);
+    if(_seq.load(std::memory_order_seq_cst) == s) {
+      pollfd pf[2];
+      pf[0].fd = _fd;
+      pf[0].events = POLLIN;
+      pf[1].fd = fd;
+      pf[1].events = POLLIN;
+      poll(pf,fd >= 0 ? 2 : 1,static_cast<int>(timeout.count()));
+    }
+    _sleepers.fetch_sub(1,std::memory_order_seq_cst);
+    //Rings that happened while nobody slept are left over: drain them.
+    uint64_t count;
+    ssize_t r(read(_fd,&count,sizeof(count)));
+    (void)r;
+    return;
+  }
+#endif
+  (void)fd;
+  auto deadline(std::chrono::steady_clock::now() + timeout);
+  while(_seq.load(std::memory_order_seq_cst) == s &&
+        std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+template < typename Q >
+inline void query_engine<Q>::set_state(int v) {
+  //seq_cst on both sides (here and in wait_change): either the waiter
+  //sees the new state, or we see the waiter.
+  _ms.store(v,std::memory_order_seq_cst);
+#ifdef __linux__
+  if(_sleepers.load(std::memory_order_seq_cst) != 0) {
+    futex_wake(&_ms);
+  }
+#endif
+  if(_bell != nullptr) { _bell->ring(); }
+}
+
+template < typename Q >
+inline void query_engine<Q>::wait_change(int v) {
+  //Answers often come back within microseconds: spin a little first.
+  for(int i(0);i != 64;++i) {
+    if(_ms.load(std::memory_order_acquire) != v) { return; }
+  }
+#ifdef __linux__
+  if(_mode == query_wait_block) {
+    _sleepers.fetch_add(1,std::memory_order_seq_cst);
+    while(_ms.load(std::memory_order_seq_cst) == v) {
+      futex_wait(&_ms,v);
+    }
+    _sleepers.fetch_sub(1,std::memory_order_seq_cst);
+    return;
+  }
+#endif
+  while(_ms.load(std::memory_order_acquire) == v) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
 template < typename Q >
 inline query_side<Q>::query_side(query_engine<Q> * q) : _qe(q) {}
 
@@ -84,15 +238,15 @@ inline bool query_side<Q>::have_answer() {
 
 template < typename Q >
 inline void query_side<Q>::wait_answer() {
-  while(!have_answer()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  if(!have_answer()) {
+    _qe->wait_change(1);
   }
 }
 
 template < typename Q >
 inline void query_side<Q>::query(Q * q) {
   _qe->_query = q;
-  (_qe->_ms).store(true,std::memory_order_release);
+  _qe->set_state(1);
 }
 
 template < typename Q >
@@ -105,8 +259,8 @@ inline bool answer_side<Q>::have_query() {
 
 template < typename Q >
 inline void answer_side<Q>::wait_query() {
-  while(!have_query()) {
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  if(!have_query()) {
+    _qe->wait_change(0);
   }
 }
 
@@ -117,11 +271,12 @@ inline Q * answer_side<Q>::get_query() {
 
 template < typename Q >
 inline void answer_side<Q>::answer() {
-  (_qe->_ms).store(false,std::memory_order_release);
+  _qe->set_state(0);
 }
 
 template < typename Q >
-inline query_engine<Q>::query_engine() : _query(nullptr),_ms(false) {}
+inline query_engine<Q>::query_engine(query_wait_mode m) : _query(nullptr),
+  _ms(0),_sleepers(0),_mode(m),_bell(nullptr) {}
 
 template < typename Q >
 inline query_side<Q> query_engine<Q>::get_query_side() {
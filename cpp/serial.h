@@ -0,0 +1,77 @@
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <cstddef>
+#include <cinttypes>
+#include <string>
+
+/* Little-endian building blocks for the binary formats
+   (grid/job serialization and everything built on top of them).
+   Writers append to a string buffer, the reader walks a [l,u) window
+   of a string and reports truncated data by returning false. */
+
+inline void put_u8(std::string & buf,uint8_t v) {
+  buf.push_back(static_cast<char>(v));
+}
+
+inline void put_u32(std::string & buf,uint32_t v) {
+  for(int i(0);i != 4;++i) {
+    buf.push_back(static_cast<char>((v >> (8*i)) & 0xff));
+  }
+}
+
+inline void put_i32(std::string & buf,int32_t v) {
+  put_u32(buf,static_cast<uint32_t>(v));
+}
+
+class serial_reader {
+public:
+  inline serial_reader(const std::string & s,size_t l,size_t u) :
+    _s(s),_p(l),_u(u < s.size() ? u : s.size()) {
+    if(_p > _u) { _p = _u; }
+  }
+  //Current position.
+  inline size_t pos() const { return _p; }
+  //Upper bound of the window.
+  inline size_t end() const { return _u; }
+  inline bool at_end() const { return _p == _u; }
+  inline bool get_u8(uint8_t & v) {
+    if(_p >= _u) { return false; }
+    v = static_cast<uint8_t>(_s[_p++]);
+    return true;
+  }
+  inline bool get_i8(int8_t & v) {
+    uint8_t r;
+    if(!get_u8(r)) { return false; }
+    v = static_cast<int8_t>(r);
+    return true;
+  }
+  inline bool get_u32(uint32_t & v) {
+    if(_u - _p < 4) { return false; }
+    v = 0;
+    for(int i(0);i != 4;++i) {
+      v |= static_cast<uint32_t>(static_cast<uint8_t>(_s[_p++])) << (8*i);
+    }
+    return true;
+  }
+  inline bool get_i32(int32_t & v) {
+    uint32_t r;
+    if(!get_u32(r)) { return false; }
+    v = static_cast<int32_t>(r);
+    return true;
+  }
+  //Skip n bytes.
+  inline bool skip(size_t n) {
+    if(_u - _p < n) { return false; }
+    _p += n;
+    return true;
+  }
+private:
+  const std::string & _s;
+  size_t _p;
+  size_t _u;
+};
+
+#endif
+
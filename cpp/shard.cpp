@@ -0,0 +1,90 @@
+
+#include "shard.h"
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+  //A job and its estimated subtree size.
+  struct shard_job {
+    std::unique_ptr<grid_job> j;
+    uint64_t estimate;
+  };
+
+}
+
+std::string shard_file(const std::string & prefix,unsigned i) {
+  return(prefix + "." + std::to_string(i));
+}
+
+bool write_shards(const std::string & prefix,
+                  unsigned count,
+                  dims size,
+                  int initial_guess,
+                  const grid * best_grid,
+                  int symmetry,
+                  dims rows,
+                  std::vector<uint64_t> & loads,
+                  size_t & jobs) {
+  std::unique_ptr<grid_job> start(grid_job::make(size,initial_guess,
+                                                 grid_engine_recursive,
+                                                 symmetry));
+  std::vector< std::unique_ptr<grid_job> > prefixes;
+  grid_job::expand(*start,rows,prefixes);
+  std::vector<shard_job> sj;
+  std::vector< std::unique_ptr<grid_job> > children;
+  for(auto & p : prefixes) {
+    uint64_t estimate(1);
+    //The last row is not worth estimating.
+    if(rows + 1 < size) {
+      grid_job::expand(*p,rows + 1,children);
+      if(children.size() > estimate) { estimate = children.size(); }
+      children.clear();
+    }
+    sj.push_back(shard_job{std::move(p),estimate});
+  }
+  jobs = sj.size();
+  std::stable_sort(sj.begin(),sj.end(),
+                   [](const shard_job & a,const shard_job & b) {
+                     return(a.estimate > b.estimate);
+                   });
+  std::vector< std::vector< std::unique_ptr<grid_job> > > shards(count);
+  loads.assign(count,0);
+  for(auto & j : sj) {
+    size_t lightest(std::min_element(loads.begin(),loads.end()) -
+                    loads.begin());
+    loads[lightest] += j.estimate;
+    shards[lightest].push_back(std::move(j.j));
+  }
+  for(unsigned i(0);i != count;++i) {
+    //Pools are used as stacks: the largest job of a shard goes last, so
+    //that it runs first.
+    std::reverse(shards[i].begin(),shards[i].end());
+    if(!write_checkpoint(shard_file(prefix,i),size,initial_guess,best_grid,
+                         shards[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool merge_shards(const std::string & prefix,
+                  unsigned count,
+                  grid_checkpoint & out,
+                  unsigned & unfinished) {
+  unfinished = 0;
+  for(unsigned i(0);i != count;++i) {
+    grid_checkpoint c;
+    if(!read_checkpoint(shard_file(prefix,i),c)) { return false; }
+    if(i != 0 && c.size != out.size) { return false; }
+    out.size = c.size;
+    if(!c.jobs.empty()) { ++unfinished; }
+    //Every shard starts from the same guess (and grid).
+    if(i == 0 || c.optimum > out.optimum) {
+      out.optimum = c.optimum;
+      out.best_grid = std::move(c.best_grid);
+    }
+  }
+  return true;
+}
+
@@ -0,0 +1,45 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "checkpoint.h"
+
+/* Static decomposition of a search into shard files, to be solved by
+   processes that never talk to each other (batch clusters).
+   The search (recursive engine) is expanded up to the grids whose first
+   rows are complete (see grid_job::expand), each one becoming a job.
+   Jobs are spread over the shards largest first, each to the lightest
+   shard so far, by their estimated subtree size: the number of grids
+   they expand to one row further.
+   Shards are checkpoint files: a shard is solved by resuming it, and its
+   final checkpoint holds its optimum and best grid. */
+
+//File of shard i.
+std::string shard_file(const std::string & prefix,unsigned i);
+
+//Write count shards of a problem, expanded to the given number of rows
+//(1 to size-1), the jobs starting from initial_guess (best_grid, if not
+//null, having that many rooks). Gives the estimated load of every shard
+//and the number of jobs. False on I/O failure.
+bool write_shards(const std::string & prefix,
+                  unsigned count,
+                  dims size,
+                  int initial_guess,
+                  const grid * best_grid,
+                  int symmetry,
+                  dims rows,
+                  std::vector<uint64_t> & loads,
+                  size_t & jobs);
+
+//Best optimum (and grid, if any) of count shards, and the number of
+//shards still holding jobs (not solved to the end). False if a shard
+//cannot be read or is not of the same size as the others.
+bool merge_shards(const std::string & prefix,
+                  unsigned count,
+                  grid_checkpoint & out,
+                  unsigned & unfinished);
+
+#endif
+
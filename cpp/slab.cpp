@@ -0,0 +1,99 @@
+//Comment out to make slab_alloc a plain (counted) malloc.
+#define SLAB_POOL
+#include "slab.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+  
+  const size_t slab_class_bytes = 64;
+  //Up to 16 KB: grids up to size 126 with 128 bits words.
+  const size_t slab_classes = 256;
+  const unsigned slab_depth = 256;
+  
+  std::atomic<uint64_t> mallocs(0);
+  
+  //Blocks are linked through their first word.
+  struct slab_list {
+    void * head;
+    unsigned count;
+  };
+  
+  //Plain data, so that no thread_local destructor runs behind
+  //the back of late frees: slab_release is explicit.
+  thread_local slab_list slab_lists[slab_classes];
+  
+  /* malloc, aligned by hand (posix_memalign is much slower), with the
+     pointer to free stored just before the block. */
+  void * raw_alloc(size_t bytes) {
+    mallocs.fetch_add(1,std::memory_order_relaxed);
+    void * raw(std::malloc(bytes + slab_class_bytes + sizeof(void *)));
+    if(raw == NULL) { throw(std::bad_alloc()); }
+    uintptr_t a((reinterpret_cast<uintptr_t>(raw) + sizeof(void *) +
+                 slab_class_bytes - 1) & ~(slab_class_bytes - 1));
+    void ** p(reinterpret_cast<void **>(a));
+    p[-1] = raw;
+    return(p);
+  }
+  
+  void raw_free(void * p) {
+    std::free(static_cast<void **>(p)[-1]);
+  }
+  
+}
+
+void * slab_alloc(size_t bytes) {
+#ifdef SLAB_POOL
+  //The first word of a block links it in its pool.
+  size_t c(bytes == 0 ? 1 : (bytes + slab_class_bytes - 1) / slab_class_bytes);
+  if(c < slab_classes) {
+    slab_list & l(slab_lists[c]);
+    if(l.head != NULL) {
+      void * p(l.head);
+      l.head = *static_cast<void **>(p);
+      --l.count;
+      return(p);
+    }
+    //Whole class size: the block may serve any size of the class.
+    return(raw_alloc(c * slab_class_bytes));
+  }
+#endif
+  return(raw_alloc(bytes));
+}
+
+void slab_free(void * p,size_t bytes) {
+  if(p == NULL) { return; }
+#ifdef SLAB_POOL
+  size_t c(bytes == 0 ? 1 : (bytes + slab_class_bytes - 1) / slab_class_bytes);
+  if(c < slab_classes) {
+    slab_list & l(slab_lists[c]);
+    if(l.count != slab_depth) {
+      *static_cast<void **>(p) = l.head;
+      l.head = p;
+      ++l.count;
+      return;
+    }
+  }
+#else
+  (void)bytes;
+#endif
+  raw_free(p);
+}
+
+void slab_release() {
+  for(size_t c(0);c != slab_classes;++c) {
+    slab_list & l(slab_lists[c]);
+    while(l.head != NULL) {
+      void * p(l.head);
+      l.head = *static_cast<void **>(p);
+      raw_free(p);
+    }
+    l.count = 0;
+  }
+}
+
+uint64_t slab_mallocs() {
+  return(mallocs.load(std::memory_order_relaxed));
+}
+
@@ -0,0 +1,26 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <cstddef>
+#include <cinttypes>
+
+/* Per-thread pools of memory blocks, by 64 bytes size classes, for the
+   grids and jobs that workers keep allocating and freeing when the
+   search is split. A freed block goes to the pool of the freeing thread
+   (slab_depth blocks per class at most, the rest goes back to free),
+   and serves the next allocation of its class by that thread without
+   any malloc. Blocks are 64-byte aligned.
+   Pools are per thread: no locking. A block may be freed by another
+   thread than the one which allocated it. */
+
+//Block of at least bytes bytes.
+void * slab_alloc(size_t bytes);
+//Give back a block of slab_alloc, with the same size.
+void slab_free(void * p,size_t bytes);
+//Free every pooled block of the calling thread at once.
+void slab_release();
+//Number of blocks obtained from malloc so far, by every thread.
+uint64_t slab_mallocs();
+
+#endif
+
@@ -0,0 +1,13 @@
+
+#include "transposition.h"
+
+transposition_table::transposition_table(size_t bytes) :
+  _entries(),_mask(0) {
+  size_t n(1);
+  while(2 * n * sizeof(entry) <= bytes) { n *= 2; }
+  //Value-initialized (zeroed): a key matches a blank entry with
+  //negligible odds.
+  _entries.reset(new entry[n]());
+  _mask = n - 1;
+}
+
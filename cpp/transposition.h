@@ -0,0 +1,98 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cinttypes>
+#include <cstring>
+#include <memory>
+
+//128 bits hash of a search state.
+struct table_key {
+  uint64_t lo;
+  uint64_t hi;
+};
+
+/* Hash a search state, 64 bits after another, in two independent
+   multiplicative lanes. */
+class table_hasher {
+public:
+  inline table_hasher() : _lo(0x243f6a8885a308d3ULL),
+    _hi(0x13198a2e03707344ULL) {}
+  inline void add(uint64_t v) {
+    _lo = (((_lo << 23) | (_lo >> 41)) ^ v) * 0x9e3779b97f4a7c15ULL;
+    _hi = (_hi ^ v ^ (_hi >> 31)) * 0xd6e8feb86659fd93ULL;
+  }
+  //Bytes of an array (of bitsets): narrow words go 64 bits at a time.
+  inline void add_bytes(const void * p,size_t n) {
+    const unsigned char * c(static_cast<const unsigned char *>(p));
+    for(;n >= 8;n -= 8,c += 8) {
+      uint64_t v;
+      std::memcpy(&v,c,8);
+      add(v);
+    }
+    if(n != 0) {
+      uint64_t v(0);
+      std::memcpy(&v,c,n);
+      add(v);
+    }
+  }
+  inline table_key key() const {
+    return(table_key{mix(_lo ^ _hi),mix(_hi + 0x2545f4914f6cdd1dULL)});
+  }
+private:
+  static inline uint64_t mix(uint64_t v) {
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    return(v ^ (v >> 33));
+  }
+  uint64_t _lo;
+  uint64_t _hi;
+};
+
+/* Bounded table from search states to an upper bound on the rooks their
+   subtree can still add, shared by every worker of a search without any
+   lock. Entries are two words written independently: the first one is
+   the key xored with the second one (the data), so that an entry torn
+   by concurrent stores does not match any key, and reads as a miss.
+   A store always replaces the entry of its slot. */
+class transposition_table {
+public:
+  //Table of at most bytes bytes (a power of two of entries, 1 at least).
+  explicit transposition_table(size_t bytes);
+  transposition_table(const transposition_table &) = delete;
+  transposition_table & operator=(const transposition_table &) = delete;
+  //Bound stored for k, if any.
+  inline bool probe(const table_key & k,int & bound) const {
+    const entry & e(_entries[k.hi & _mask]);
+    uint64_t d(e.data.load(std::memory_order_relaxed));
+    uint64_t c(e.check.load(std::memory_order_relaxed));
+    if((c ^ d) != k.lo || (d & ~data_mask) != (k.hi & ~data_mask)) {
+      return false;
+    }
+    bound = static_cast<int>(d & data_mask);
+    return true;
+  }
+  //Bounds are 16 bits at most.
+  inline void store(const table_key & k,int bound) {
+    entry & e(_entries[k.hi & _mask]);
+    uint64_t d((k.hi & ~data_mask) | (static_cast<uint64_t>(bound) & data_mask));
+    e.check.store(k.lo ^ d,std::memory_order_relaxed);
+    e.data.store(d,std::memory_order_relaxed);
+  }
+  //Memory used by the entries.
+  inline size_t bytes() const { return((_mask + 1) * sizeof(entry)); }
+private:
+  static const uint64_t data_mask = 0xffff;
+  struct entry {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+  std::unique_ptr<entry[]> _entries;
+  size_t _mask;
+};
+
+#endif
+
@@ -13,6 +13,8 @@
 #endif
 
 static uint64_t conf_counter = 0;
+//Number of rooks put (search nodes).
+static uint64_t node_counter = 0;
 
 //bit-set type. Do not forget
 //to change the type size accordingly or
@@ -102,6 +104,7 @@ void print_conf(grid * g) {
 //Fill a saving structure.
 static inline void add_rook(dims x,dims y,grid * g,saved * s) {
   dims level = g->lv;
+  ++node_counter;
   ++(g->rooks);
   bitfield bx = 1 << x;
   bitfield by = 1 << y;
@@ -373,6 +376,15 @@ int main(int argc,const char * argv[]) {
   //DO NOT PUT 0 HERE ;)
   int len = 8;
   grid g;
+  if(argc > 1) {
+    len = atoi(argv[1]);
+  }
+  //Bit-sets hold a whole line.
+  if(len < 1 || len > 8 * (int) sizeof(bitfield)) {
+    fprintf(stderr,"usage: %s [size], size from 1 to %d\n",
+      argv[0],8 * (int) sizeof(bitfield));
+    return(1);
+  }
   fill_grid(&g,len);
   #ifdef ROOKS_MONITOR
   pthread_create(&t, NULL, monitor, &g);
@@ -384,6 +396,7 @@ int main(int argc,const char * argv[]) {
   #endif
   printf("Result: %d\n",max);
   printf("Explored confs: %" PRIu64 "\n",conf_counter);
+  printf("Explored nodes: %" PRIu64 "\n",node_counter);
   free_grid(&g);
   return(0);
 }